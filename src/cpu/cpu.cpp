@@ -8,6 +8,10 @@ namespace cpu
 {
 
 JitMode gJitMode = JitMode::Disabled;
+static InterpreterMode sInterpreterMode = InterpreterMode::Stepped;
+static unsigned sJitCompileThreads = 0;
+static JitFpscrMode sJitFpscrMode = JitFpscrMode::Accurate;
+static JitProfileMode sJitProfileMode = JitProfileMode::Disabled;
 static std::vector<KernelCallEntry> sKernelCalls;
 
 void setJitMode(JitMode mode)
@@ -15,22 +19,73 @@ void setJitMode(JitMode mode)
    gJitMode = mode;
 }
 
+JitMode getJitMode()
+{
+   return gJitMode;
+}
+
+void setInterpreterMode(InterpreterMode mode)
+{
+   sInterpreterMode = mode;
+}
+
+void setJitCompileThreads(unsigned count)
+{
+   sJitCompileThreads = count;
+}
+
+void setJitFpscrMode(JitFpscrMode mode)
+{
+   sJitFpscrMode = mode;
+}
+
+JitFpscrMode getJitFpscrMode()
+{
+   return sJitFpscrMode;
+}
+
+void setJitProfileMode(JitProfileMode mode)
+{
+   sJitProfileMode = mode;
+}
+
+JitProfileMode getJitProfileMode()
+{
+   return sJitProfileMode;
+}
+
 void initialise()
 {
    gInstructionTable.initialise();
    cpu::interpreter::initialise();
    cpu::jit::initialise();
+
+   if (sJitCompileThreads) {
+      cpu::jit::startCompileThreads(sJitCompileThreads);
+   }
 }
 
 void executeSub(ThreadState *state)
 {
    if (gJitMode == JitMode::Enabled) {
       jit::executeSub(state);
+   } else if (gJitMode == JitMode::Debug) {
+      jit::executeVerifiedSub(state);
+   } else if (gJitMode == JitMode::Tiered) {
+      jit::executeTieredSub(state);
+   } else if (sInterpreterMode == InterpreterMode::Threaded) {
+      interpreter::executeThreadedSub(state);
    } else {
       interpreter::executeSub(state);
    }
 }
 
+void invalidateCode(uint32_t address, uint32_t size)
+{
+   interpreter::invalidate(address, size);
+   jit::invalidate(address, size);
+}
+
 uint32_t registerKernelCall(KernelCallEntry &entry)
 {
    sKernelCalls.push_back(entry);
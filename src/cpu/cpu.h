@@ -15,14 +15,51 @@ namespace cpu
    enum class JitMode {
       Enabled,
       Disabled,
-      Debug
+      Debug,
+      Tiered
+   };
+
+   enum class InterpreterMode {
+      // Check interrupts and breakpoints before every instruction
+      Stepped,
+
+      // Check interrupts between blocks of instructions
+      Threaded
+   };
+
+   enum class JitFpscrMode {
+      // Float instructions update FPSCR exactly like the interpreter
+      Accurate,
+
+      // Float instructions skip FPSCR exception and FPRF updates
+      Fast
+   };
+
+   enum class JitProfileMode {
+      Disabled,
+
+      // Count entries and interpreter fallbacks of each block
+      Counts,
+
+      // Also charge host cycles to the block last entered
+      Cycles
    };
 
    void setJitMode(JitMode mode);
+   JitMode getJitMode();
+   void setInterpreterMode(InterpreterMode mode);
+   void setJitCompileThreads(unsigned count);
+   void setJitFpscrMode(JitFpscrMode mode);
+   JitFpscrMode getJitFpscrMode();
+   void setJitProfileMode(JitProfileMode mode);
+   JitProfileMode getJitProfileMode();
 
    void initialise();
    void executeSub(ThreadState *state);
 
+   // Drops everything compiled or decoded from guest code in the range
+   void invalidateCode(uint32_t address, uint32_t size);
+
    typedef void (*KernelCallFn)(ThreadState *state, void *userData);
    typedef std::pair<KernelCallFn, void*> KernelCallEntry;
    uint32_t registerKernelCall(KernelCallEntry &entry);
@@ -54,9 +54,35 @@ struct TableEntry
    std::vector<FieldMap> fieldMaps;
 };
 
+// Direct lookup on the primary opcode, then for primary opcodes with
+//   extended opcodes on the 10 bits of xo1 which all xo fields lie in.
+//   Entries are indices into instructionData.
+static const uint16_t InvalidIndex = 0xFFFF;
+static const uint16_t NoSecondaryTable = 0xFFFF;
+static const uint32_t SecondaryTableShift = 1;
+static const uint32_t SecondaryTableSize = 1 << 10;
+static const uint32_t SecondaryTableMask = make_bitmask<0, 9, uint32_t>() << SecondaryTableShift;
+
+struct PrimaryEntry
+{
+   uint16_t index = InvalidIndex;
+   uint16_t table = NoSecondaryTable;
+};
+
+// Bits every opcode field of an instruction covers and their values,
+//   lets decode reject encodings with reserved bits set.
+struct OpcodeMask
+{
+   uint32_t mask;
+   uint32_t value;
+};
+
 static std::vector<InstructionData> instructionData;
 static std::vector<InstructionAlias> aliasData;
 static TableEntry instructionTable;
+static PrimaryEntry primaryTable[64];
+static std::vector<uint16_t> secondaryTable;
+static std::vector<OpcodeMask> opcodeMasks;
 
 static void
 initData();
@@ -64,6 +90,9 @@ initData();
 static void
 initTable();
 
+static void
+initFlatTable();
+
 #define FLD(x, y, z, ...) {y, z},
 #define MRKR(x, ...) {-1, -1},
 static BitRange gFieldBits[] = {
@@ -139,6 +168,31 @@ InstructionTable::find(InstructionID instrId)
 // Decode Instruction to InstructionData
 InstructionData *
 InstructionTable::decode(Instruction instr)
+{
+   auto &primary = primaryTable[instr.opcd];
+   auto index = primary.index;
+
+   if (primary.table != NoSecondaryTable) {
+      auto secondary = (instr.value & SecondaryTableMask) >> SecondaryTableShift;
+      index = secondaryTable[primary.table * SecondaryTableSize + secondary];
+   }
+
+   if (index == InvalidIndex) {
+      return nullptr;
+   }
+
+   auto &opcode = opcodeMasks[index];
+   if ((instr.value & opcode.mask) != opcode.value) {
+      return nullptr;
+   }
+
+   return &instructionData[index];
+}
+
+// Decode by walking the opcode field tree, slower than decode but
+//   built directly from the opcode descriptions
+InstructionData *
+InstructionTable::decodeTree(Instruction instr)
 {
    TableEntry *table = &instructionTable;
    InstructionData *data = nullptr;
@@ -234,6 +288,7 @@ InstructionTable::initialise()
 {
    initData();
    initTable();
+   initFlatTable();
 }
 
 // Initialise instructionTable
@@ -259,6 +314,57 @@ initTable()
    }
 }
 
+// Initialise primaryTable and secondaryTable
+void
+initFlatTable()
+{
+   opcodeMasks.clear();
+   secondaryTable.clear();
+
+   for (auto &instr : instructionData) {
+      OpcodeMask opcode = { 0, 0 };
+
+      for (auto &op : instr.opcode) {
+         opcode.mask |= getFieldBitmask(op.field);
+         opcode.value |= op.value << getFieldStart(op.field);
+      }
+
+      opcodeMasks.push_back(opcode);
+   }
+
+   for (auto i = 0u; i < instructionData.size(); ++i) {
+      auto &opcode = opcodeMasks[i];
+      auto &primary = primaryTable[opcode.value >> 26];
+
+      if (!(opcode.mask & SecondaryTableMask)) {
+         assert(primary.index == InvalidIndex);
+         primary.index = static_cast<uint16_t>(i);
+         continue;
+      }
+
+      if (primary.table == NoSecondaryTable) {
+         primary.table = static_cast<uint16_t>(secondaryTable.size() / SecondaryTableSize);
+         secondaryTable.resize(secondaryTable.size() + SecondaryTableSize, InvalidIndex);
+      }
+
+      auto mask = (opcode.mask & SecondaryTableMask) >> SecondaryTableShift;
+      auto value = (opcode.value & SecondaryTableMask) >> SecondaryTableShift;
+
+      for (auto secondary = 0u; secondary < SecondaryTableSize; ++secondary) {
+         if ((secondary & mask) == value) {
+            auto &entry = secondaryTable[primary.table * SecondaryTableSize + secondary];
+            assert(entry == InvalidIndex);
+            entry = static_cast<uint16_t>(i);
+         }
+      }
+   }
+
+   // A primary opcode needs either a direct entry or a secondary table
+   for (auto &primary : primaryTable) {
+      assert(primary.index == InvalidIndex || primary.table == NoSecondaryTable);
+   }
+}
+
 std::string cleanInsName(const std::string& name)
 {
    if (name[name.size() - 1] == '_') {
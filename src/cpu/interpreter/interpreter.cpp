@@ -1,3 +1,6 @@
+#include <atomic>
+#include <mutex>
+#include <vector>
 #include "interpreter.h"
 #include "interpreter_insreg.h"
 #include "../instructiondata.h"
@@ -12,9 +15,51 @@ namespace cpu
 namespace interpreter
 {
 
+   static const uint32_t DecodePageShift = 12;
+   static const uint32_t DecodePageCount = 1 << (32 - DecodePageShift);
+   static const uint32_t DecodePageMask = (1 << DecodePageShift) - 1;
+   static const uint32_t DecodePageEntries = (1 << DecodePageShift) / 4;
+
+   struct DecodedInstruction {
+      Instruction instr;
+      InstructionData *data;
+      instrfptr_t fptr;
+   };
+
+   // Every instruction slot of a guest page, decoded in one go the
+   //   first time any of them is executed.
+   struct DecodedPage {
+      DecodedInstruction entries[DecodePageEntries];
+   };
+
    static std::vector<instrfptr_t>
    sInstructionMap;
 
+   static std::atomic<DecodedPage*> sDecodedPages[DecodePageCount];
+   static std::atomic<uint32_t> sDecodeEpoch { 0 };
+
+   // One bit per guest page which has ever been decoded, set before the
+   //   decode reads memory, lets invalidate skip writes to data.
+   static std::atomic<uint32_t> sDecodedPageBits[DecodePageCount / 32];
+
+   // Pages dropped by invalidate are freed once no thread can still be
+   //   using them. Each thread running the interpreter publishes the
+   //   reclaim epoch it last saw before looking up a page, or
+   //   EpochOffline while it holds none, and a page retired in epoch N
+   //   is freed once every online thread has published a later one.
+   static const uint32_t EpochOffline = 0;
+
+   struct RetiredPage {
+      DecodedPage *page;
+      uint32_t epoch;
+   };
+
+   static std::atomic<uint32_t> sReclaimEpoch { 1 };
+   static std::mutex sRetiredPagesMutex;
+   static std::vector<RetiredPage> sRetiredPages;
+   static std::vector<std::atomic<uint32_t>*> sReaderEpochs;
+   static thread_local std::atomic<uint32_t> *tReaderEpoch = nullptr;
+
    void initialise()
    {
       sInstructionMap.resize(static_cast<size_t>(InstructionID::InstructionCount), nullptr);
@@ -48,43 +93,273 @@ namespace interpreter
       return getInstructionHandler(instrId) != nullptr;
    }
 
-   void execute(ThreadState *state)
+   static std::atomic<uint32_t> *
+   registerReader()
    {
-      while (state->nia != cpu::CALLBACK_ADDR) {
-         // TankTankTank decryptor fn
-         //forceJit = state->nia >= 0x0250B648 && state->nia < 0x0250B8B8;
+      std::unique_lock<std::mutex> lock(sRetiredPagesMutex);
+      tReaderEpoch = new std::atomic<uint32_t> { EpochOffline };
+      sReaderEpochs.push_back(tReaderEpoch);
+      return tReaderEpoch;
+   }
 
-         // Handle interrupts
-         gProcessor.handleInterrupt();
+   // Called before every page lookup, a thread coming back online needs
+   //   the fence so it can't see a page freed while it was offline.
+   static void
+   enterPages()
+   {
+      auto reader = tReaderEpoch;
 
-         // Interpreter Loop!
-         state->cia = state->nia;
-         state->nia = state->cia + 4;
+      if (!reader) {
+         reader = registerReader();
+      }
 
-         gDebugControl.maybeBreak(state->cia, state, gProcessor.getCoreID());
+      auto epoch = sReclaimEpoch.load(std::memory_order_acquire);
 
-         auto instr = mem::read<Instruction>(state->cia);
-         auto data = gInstructionTable.decode(instr);
+      if (reader->load(std::memory_order_relaxed) == EpochOffline) {
+         reader->store(epoch, std::memory_order_relaxed);
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+      } else {
+         reader->store(epoch, std::memory_order_release);
+      }
+   }
 
-         if (!data) {
-            gLog->error("Could not decode instruction at {:08x} = {:08x}", state->cia, instr.value);
+   void leavePages()
+   {
+      if (tReaderEpoch) {
+         tReaderEpoch->store(EpochOffline, std::memory_order_release);
+      }
+   }
+
+   // Must be called with sRetiredPagesMutex held
+   static void
+   reclaimPages()
+   {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto oldest = sReclaimEpoch.load();
+
+      for (auto reader : sReaderEpochs) {
+         auto epoch = reader->load(std::memory_order_acquire);
+
+         if (epoch != EpochOffline && epoch < oldest) {
+            oldest = epoch;
          }
-         assert(data);
+      }
 
-         auto trace = traceInstructionStart(instr, data, state);
-         auto fptr = sInstructionMap[static_cast<size_t>(data->id)];
+      auto keep = sRetiredPages.begin();
 
-         if (!fptr) {
-            gLog->error("Unimplemented interpreter instruction {}", data->name);
+      for (auto &retired : sRetiredPages) {
+         if (retired.epoch < oldest) {
+            delete retired.page;
+         } else {
+            *keep++ = retired;
          }
-         assert(fptr);
+      }
 
-         fptr(state, instr);
+      sRetiredPages.erase(keep, sRetiredPages.end());
+   }
+
+   static void
+   retirePage(DecodedPage *page)
+   {
+      std::unique_lock<std::mutex> lock(sRetiredPagesMutex);
+      sRetiredPages.push_back({ page, sReclaimEpoch.fetch_add(1) });
+      reclaimPages();
+   }
+
+   static DecodedPage *
+   decodePage(uint32_t base)
+   {
+      if (!mem::valid(base) || !mem::valid(base + DecodePageMask)) {
+         return nullptr;
+      }
+
+      auto index = base >> DecodePageShift;
+      sDecodedPageBits[index / 32].fetch_or(1u << (index % 32));
+
+      auto page = new DecodedPage();
+
+      for (auto i = 0u; i < DecodePageEntries; ++i) {
+         auto &entry = page->entries[i];
+         entry.instr = mem::read<Instruction>(base + i * 4);
+         entry.data = gInstructionTable.decode(entry.instr);
+         entry.fptr = entry.data ? sInstructionMap[static_cast<size_t>(entry.data->id)] : nullptr;
+      }
+
+      return page;
+   }
+
+   // Returns nullptr when the instruction has to be decoded from memory,
+   //   leaving the error handling of bad instructions to step.
+   static const DecodedInstruction *
+   lookupInstruction(uint32_t addr)
+   {
+      enterPages();
+
+      auto &pagePtr = sDecodedPages[addr >> DecodePageShift];
+      auto page = pagePtr.load(std::memory_order_acquire);
+
+      if (!page) {
+         auto epoch = sDecodeEpoch.load();
+         auto newPage = decodePage(addr & ~DecodePageMask);
+
+         if (!newPage) {
+            return nullptr;
+         }
 
+         if (!pagePtr.compare_exchange_strong(page, newPage)) {
+            delete newPage;
+         } else if (epoch != sDecodeEpoch.load()) {
+            // The page was written while we decoded it, unpublish it
+            //   unless invalidate already has.
+            auto expected = newPage;
+            pagePtr.compare_exchange_strong(expected, nullptr);
+            retirePage(newPage);
+            return nullptr;
+         } else {
+            page = newPage;
+         }
+      }
+
+      auto entry = &page->entries[(addr & DecodePageMask) >> 2];
+      return entry->fptr ? entry : nullptr;
+   }
+
+   void invalidate(uint32_t address, uint32_t size)
+   {
+      if (!size) {
+         return;
+      }
+
+      auto first = address >> DecodePageShift;
+      auto last = (address + size - 1) >> DecodePageShift;
+      auto decoded = false;
+
+      // Orders the guest's write before the bit checks, a decode which
+      //   sets its bit later is sure to read the new memory.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      for (auto i = first; i <= last && !decoded; ++i) {
+         decoded = !!(sDecodedPageBits[i / 32].load(std::memory_order_relaxed) & (1u << (i % 32)));
+      }
+
+      if (!decoded) {
+         return;
+      }
+
+      sDecodeEpoch++;
+
+      for (auto i = first; i <= last; ++i) {
+         auto page = sDecodedPages[i].exchange(nullptr);
+
+         if (page) {
+            retirePage(page);
+         }
+      }
+   }
+
+   static void
+   decodeInstruction(uint32_t cia, Instruction &instr, InstructionData *&data, instrfptr_t &fptr)
+   {
+#ifdef JIT_VERIFY_ENABLED
+      // Decoding a page through a memory overlay would cache its stores
+      auto decoded = mem::tOverlay ? nullptr : lookupInstruction(cia);
+#else
+      auto decoded = lookupInstruction(cia);
+#endif
+
+      if (decoded) {
+         instr = decoded->instr;
+         data = decoded->data;
+         fptr = decoded->fptr;
+         return;
+      }
+
+      instr = mem::read<Instruction>(cia);
+      data = gInstructionTable.decode(instr);
+
+      if (!data) {
+         gLog->error("Could not decode instruction at {:08x} = {:08x}", cia, instr.value);
+      }
+      assert(data);
+
+      fptr = sInstructionMap[static_cast<size_t>(data->id)];
+
+      if (!fptr) {
+         gLog->error("Unimplemented interpreter instruction {}", data->name);
+      }
+      assert(fptr);
+   }
+
+   template<bool Trace>
+   static void
+   step(ThreadState *state)
+   {
+      // TankTankTank decryptor fn
+      //forceJit = state->nia >= 0x0250B648 && state->nia < 0x0250B8B8;
+
+      // Handle interrupts
+      gProcessor.handleInterrupt();
+
+      // Interpreter Loop!
+      state->cia = state->nia;
+      state->nia = state->cia + 4;
+
+      gDebugControl.maybeBreak(state->cia, state, gProcessor.getCoreID());
+
+      Instruction instr;
+      InstructionData *data;
+      instrfptr_t fptr;
+      decodeInstruction(state->cia, instr, data, fptr);
+
+      if (Trace) {
+         auto trace = traceInstructionStart(instr, data, state);
+         fptr(state, instr);
          traceInstructionEnd(trace, instr, data, state);
+      } else {
+         fptr(state, instr);
+      }
+   }
+
+   static void
+   step(ThreadState *state)
+   {
+      if (TraceEnabled && state->tracer) {
+         step<true>(state);
+      } else {
+         step<false>(state);
       }
    }
 
+   void executeInstruction(ThreadState *state)
+   {
+      Instruction instr;
+      InstructionData *data;
+      instrfptr_t fptr;
+
+      state->cia = state->nia;
+      state->nia = state->cia + 4;
+
+      decodeInstruction(state->cia, instr, data, fptr);
+      fptr(state, instr);
+      leavePages();
+   }
+
+   void execute(ThreadState *state)
+   {
+      while (state->nia != cpu::CALLBACK_ADDR) {
+         step(state);
+      }
+   }
+
+   void executeBlock(ThreadState *state)
+   {
+      do {
+         step(state);
+      } while (state->nia == state->cia + 4 && state->nia != cpu::CALLBACK_ADDR);
+
+      leavePages();
+   }
+
 
    void executeSub(ThreadState *state)
    {
@@ -92,6 +367,77 @@ namespace interpreter
       state->lr = CALLBACK_ADDR;
 
       execute(state);
+      leavePages();
+
+      state->lr = lr;
+   }
+
+   // Runs predecoded instructions from nia until a taken branch, a kernel
+   //   call, the end of the page or a slot which didn't decode. Kernel
+   //   calls leave the pages, so the page is not touched after one.
+   //   Without Trace the loop is nothing but the handler calls.
+   template<bool Trace>
+   static void
+   runBlock(ThreadState *state)
+   {
+      auto entry = lookupInstruction(state->nia);
+
+      if (!entry) {
+         step(state);
+         return;
+      }
+
+      auto remaining = DecodePageEntries - ((state->nia & DecodePageMask) >> 2);
+
+      auto kernelCall = false;
+
+      do {
+         state->cia = state->nia;
+         state->nia = state->cia + 4;
+         kernelCall = entry->data->id == InstructionID::kc;
+
+         if (Trace) {
+            auto instr = entry->instr;
+            auto data = entry->data;
+            auto trace = traceInstructionStart(instr, data, state);
+            entry->fptr(state, instr);
+            traceInstructionEnd(trace, instr, data, state);
+         } else {
+            entry->fptr(state, entry->instr);
+         }
+
+         ++entry;
+      } while (!kernelCall && --remaining && state->nia == state->cia + 4 && entry->fptr);
+   }
+
+   static void
+   executeThreaded(ThreadState *state)
+   {
+      while (state->nia != cpu::CALLBACK_ADDR) {
+         // Breakpoints and single stepping need every instruction,
+         //   blocks never leave the page needsStep checked.
+         if (gDebugControl.needsStep(state->nia)) {
+            step(state);
+            continue;
+         }
+
+         gProcessor.handleInterrupt();
+
+         if (TraceEnabled && state->tracer) {
+            runBlock<true>(state);
+         } else {
+            runBlock<false>(state);
+         }
+      }
+   }
+
+   void executeThreadedSub(ThreadState *state)
+   {
+      auto lr = state->lr;
+      state->lr = CALLBACK_ADDR;
+
+      executeThreaded(state);
+      leavePages();
 
       state->lr = lr;
    }
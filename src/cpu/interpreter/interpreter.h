@@ -10,5 +10,24 @@ void initialise();
 
 void executeSub(ThreadState *state);
 
+// Runs whole blocks of predecoded instructions between interrupt checks,
+//   falling back to stepping on pages with breakpoints.
+void executeThreadedSub(ThreadState *state);
+
+// Drops predecoded instructions of the range after the guest wrote to it
+void invalidate(uint32_t address, uint32_t size);
+
+// Marks this thread as holding no predecoded page, so pages dropped by
+//   invalidate can be freed while it runs host code or sleeps.
+void leavePages();
+
+// Runs the instruction at nia without checking for interrupts or
+//   breakpoints, lets the JIT verifier run code on a shadow state.
+void executeInstruction(ThreadState *state);
+
+// Runs until the next taken branch, used by the tiered JIT
+//   to interpret code which is not hot yet.
+void executeBlock(ThreadState *state);
+
 }
 }
\ No newline at end of file
@@ -402,7 +402,7 @@ fctiw(ThreadState *state, Instruction instr)
    if (b > static_cast<double>(0x7FFFFFFF)) {
       bi = 0x7FFFFFFF;
       state->fpscr.vxcvi = 1;
-   } else if (b < static_cast<double>(0x80000000)) {
+   } else if (b < static_cast<double>(INT32_MIN)) {
       bi = 0x80000000;
       state->fpscr.vxcvi = 1;
    } else {
@@ -445,7 +445,7 @@ fctiwz(ThreadState *state, Instruction instr)
    if (b > static_cast<double>(0x7FFFFFFF)) {
       bi = 0x7FFFFFFF;
       state->fpscr.vxcvi = 1;
-   } else if (b < static_cast<double>(0x80000000)) {
+   } else if (b < static_cast<double>(INT32_MIN)) {
       bi = 0x80000000;
       state->fpscr.vxcvi = 1;
    } else {
@@ -1,10 +1,12 @@
 #include <cassert>
+#include "interpreter.h"
 #include "interpreter_insreg.h"
 #include "bitutils.h"
 #include "util.h"
 #include "log.h"
 #include "memory_translate.h"
 #include "../cpu.h"
+#include "mem/mem.h"
 
 static SprEncoding
 decodeSPR(Instruction instr)
@@ -76,6 +78,15 @@ dcbz(ThreadState *state, Instruction instr)
 
    addr += state->gpr[instr.rB];
    addr = alignDown(addr, 32);
+
+#ifdef JIT_VERIFY_ENABLED
+   if (mem::tOverlay) {
+      uint8_t zero[32] = { 0 };
+      mem::tOverlay->write(addr, zero, 32);
+      return;
+   }
+#endif
+
    memset(memory_translate(addr), 0, 32);
 }
 
@@ -276,6 +287,8 @@ kc(ThreadState *state, Instruction instr)
       return;
    }
 
+   // The kernel may switch fibers or sleep here
+   cpu::interpreter::leavePages();
    kc->first(state, kc->second);
 }
 
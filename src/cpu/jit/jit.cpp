@@ -1,9 +1,25 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <thread>
 #include <vector>
+#include <Windows.h>
+#include <intrin.h>
 #include "jit.h"
 #include "jit_internal.h"
 #include "jit_insreg.h"
+#include "../interpreter/interpreter.h"
 #include "../../mem/mem.h"
 #include "../instructiondata.h"
+#include "../../debugcontrol.h"
+#include "../../debugger.h"
+#include "../../processor.h"
 #include "log.h"
 #include "bitutils.h"
 
@@ -12,12 +28,64 @@ namespace cpu
 namespace jit
 {
 
+   static const uint32_t JitPageShift = 12;
+   static const uint32_t JitPageCount = 1 << (32 - JitPageShift);
+   static const uint32_t JitPageMask = (1 << JitPageShift) - 1;
+   static const uint32_t JitPageEntries = (1 << JitPageShift) / 4;
+
+   // One entry per instruction slot of a guest page
+   struct JitBlockPage {
+      std::atomic<JitCode> entries[JitPageEntries];
+   };
+
+   // Entry counts of code which is still being interpreted
+   struct JitHotPage {
+      std::atomic<uint32_t> counts[JitPageEntries];
+   };
+
+   struct CompileRequest {
+      uint32_t addr;
+      JitTier tier;
+      JitGqrHint gqrHint;
+   };
+
    static std::vector<jitinstrfptr_t>
    sInstructionMap;
 
    static asmjit::JitRuntime* sRuntime;
-   static std::map<uint32_t, JitCode> sBlocks;
+   static std::mutex sMutex;
+   static std::atomic<JitBlockPage*> sBlockPages[JitPageCount];
+   static std::map<uint32_t, JitBlock> sBlockList;
+   static std::map<uint32_t, std::vector<uint8_t*>> sLinkSites;
+   static std::set<uint32_t> sFailedBlocks;
    static std::map<uint32_t, JitCode> sSingleBlocks;
+   static std::map<const uint8_t*, uint32_t> sHostBlocks;
+
+   // Host code ranges of published blocks, under their own lock so the
+   //   fault handler can tell JIT code apart from a fault in the emulator
+   //   itself, which may be holding sMutex.
+   static std::mutex sHostRangeMutex;
+   static std::map<const uint8_t*, const uint8_t*> sHostRanges;
+   static std::atomic<JitHotPage*> sHotPages[JitPageCount];
+   static std::deque<int32_t> sTierCounters;
+   static std::mutex sTierCounterMutex;
+
+   // Held shared while generating code, exclusively to replace the runtime
+   static std::shared_timed_mutex sRuntimeMutex;
+   static std::atomic<uint32_t> sInvalidateEpoch { 0 };
+
+   // Bumped whenever the runtime holding all generated code is replaced
+   static std::atomic<uint32_t> sCodeGeneration { 1 };
+
+   // One bit per guest page which blocks have been compiled from, lets
+   //   invalidate skip the block list for writes which can't hit code.
+   static std::atomic<uint32_t> sCodePages[JitPageCount / 32];
+
+   static std::mutex sQueueMutex;
+   static std::condition_variable sQueueCondition;
+   static std::deque<CompileRequest> sCompileQueue;
+   static std::set<uint32_t> sQueuedBlocks;
+   static std::atomic<unsigned> sCompileThreadCount { 0 };
 
    JitCall gCallFn;
    JitFinale gFinaleFn;
@@ -33,13 +101,23 @@ namespace jit
       a.push(a.zbx);
       a.push(a.zdi);
       a.push(a.zsi);
-      a.sub(a.zsp, 0x30);
+      a.push(a.zbp);
+      a.push(asmjit::x86::r12);
+      a.push(asmjit::x86::r13);
+      a.push(asmjit::x86::r14);
+      a.push(asmjit::x86::r15);
+      a.sub(a.zsp, 0x28);
       a.mov(a.zbx, a.zcx);
       a.mov(a.zsi, static_cast<uint64_t>(mem::base()));
       a.jmp(a.zdx);
 
       a.bind(extroLabel);
-      a.add(a.zsp, 0x30);
+      a.add(a.zsp, 0x28);
+      a.pop(asmjit::x86::r15);
+      a.pop(asmjit::x86::r14);
+      a.pop(asmjit::x86::r13);
+      a.pop(asmjit::x86::r12);
+      a.pop(a.zbp);
       a.pop(a.zsi);
       a.pop(a.zdi);
       a.pop(a.zbx);
@@ -50,11 +128,48 @@ namespace jit
       gFinaleFn = asmjit_cast<JitCall>(basePtr, a.getLabelOffset(extroLabel));
    }
 
+   static LONG CALLBACK
+   handleGuestFault(PEXCEPTION_POINTERS info);
+
+   const JitHostFeatures& getHostFeatures()
+   {
+      static std::once_flag once;
+      static JitHostFeatures features = { false, false };
+
+      std::call_once(once, [] {
+         int regs[4];
+
+         __cpuid(regs, 0);
+         auto maxLeaf = regs[0];
+
+         __cpuid(regs, 1);
+         features.movbe = !!(regs[2] & (1 << 22));
+
+         if (maxLeaf >= 7) {
+            __cpuidex(regs, 7, 0);
+            features.bmi2 = !!(regs[1] & (1 << 8));
+         }
+      });
+
+      return features;
+   }
+
    void initialise()
    {
       sRuntime = new asmjit::JitRuntime();
       initStubs();
 
+      AddVectoredExceptionHandler(1, handleGuestFault);
+
+      auto &features = getHostFeatures();
+      gLog->info("JIT host features: movbe {}, bmi2 {}", features.movbe, features.bmi2);
+
+#ifndef JIT_VERIFY_ENABLED
+      if (cpu::getJitMode() == cpu::JitMode::Debug) {
+         gLog->warn("Built without JIT_VERIFY_ENABLED, JIT blocks will not be verified");
+      }
+#endif
+
       sInstructionMap.resize(static_cast<size_t>(InstructionID::InstructionCount), nullptr);
 
       // Register instruction handlers
@@ -97,31 +212,697 @@ namespace jit
       }
    }
 
+   static JitCode
+   lookupBlock(uint32_t addr)
+   {
+      auto page = sBlockPages[addr >> JitPageShift].load(std::memory_order_acquire);
+      if (!page) {
+         return nullptr;
+      }
+      return page->entries[(addr & JitPageMask) >> 2].load(std::memory_order_acquire);
+   }
+
+   static void
+   setBlockEntry(uint32_t addr, JitCode code)
+   {
+      auto &pagePtr = sBlockPages[addr >> JitPageShift];
+      auto page = pagePtr.load(std::memory_order_acquire);
+
+      if (!page) {
+         if (!code) {
+            return;
+         }
+
+         page = new JitBlockPage();
+         for (auto &entry : page->entries) {
+            entry.store(nullptr, std::memory_order_relaxed);
+         }
+         pagePtr.store(page, std::memory_order_release);
+      }
+
+      page->entries[(addr & JitPageMask) >> 2].store(code, std::memory_order_release);
+   }
+
+   // Exit sites are 8 byte aligned so the 5 byte instruction can be
+   //   rewritten with a single atomic store while other cores run it.
+   static void
+   patchExitSite(uint8_t *site, uint8_t opcode, uint32_t imm)
+   {
+      auto word = reinterpret_cast<volatile LONG64*>(site);
+      auto value = static_cast<uint64_t>(*word);
+      value &= 0xFFFFFF0000000000ull;
+      value |= static_cast<uint64_t>(opcode);
+      value |= static_cast<uint64_t>(imm) << 8;
+      InterlockedExchange64(word, static_cast<LONG64>(value));
+   }
+
+   // Replace `mov eax, nia` with `jmp target`
+   static void
+   linkExitSite(uint8_t *site, JitCode target)
+   {
+      // The verifier has to get control back after each block
+      if (cpu::getJitMode() == cpu::JitMode::Debug) {
+         return;
+      }
+
+      auto rel = reinterpret_cast<intptr_t>(target) - reinterpret_cast<intptr_t>(site + 5);
+      if (rel < INT32_MIN || rel > INT32_MAX) {
+         // Out of range, leave it going through the dispatcher
+         return;
+      }
+
+      patchExitSite(site, 0xE9, static_cast<uint32_t>(rel));
+   }
+
+   // Restore `mov eax, nia` so the exit returns to the dispatcher
+   static void
+   unlinkExitSite(uint8_t *site, uint32_t nia)
+   {
+      patchExitSite(site, 0xB8, nia);
+   }
+
+   static void
+   publishEntry(uint32_t addr, JitCode code)
+   {
+      setBlockEntry(addr, code);
+
+      auto sites = sLinkSites.find(addr);
+      if (sites != sLinkSites.end()) {
+         for (auto site : sites->second) {
+            linkExitSite(site, code);
+         }
+      }
+   }
+
+   static void
+   unpublishEntry(uint32_t addr)
+   {
+      setBlockEntry(addr, nullptr);
+
+      auto sites = sLinkSites.find(addr);
+      if (sites != sLinkSites.end()) {
+         for (auto site : sites->second) {
+            unlinkExitSite(site, addr);
+         }
+      }
+   }
+
+   static void
+   markCodePages(uint32_t start, uint32_t end)
+   {
+      for (auto page = start >> JitPageShift; page <= ((end - 1) >> JitPageShift); ++page) {
+         sCodePages[page / 32].fetch_or(1u << (page % 32));
+      }
+   }
+
+   static void
+   clearCodePages(uint32_t start, uint32_t end)
+   {
+      for (auto page = start >> JitPageShift; page <= ((end - 1) >> JitPageShift); ++page) {
+         sCodePages[page / 32].fetch_and(~(1u << (page % 32)));
+      }
+   }
+
+   static bool
+   hasCodePages(uint32_t start, uint32_t end)
+   {
+      for (auto page = start >> JitPageShift; page <= ((end - 1) >> JitPageShift); ++page) {
+         if (sCodePages[page / 32].load() & (1u << (page % 32))) {
+            return true;
+         }
+      }
+
+      return false;
+   }
+
+   static void
+   markBlockPages(const JitBlock& block)
+   {
+      markCodePages(block.start, block.end);
+
+      for (auto &callee : block.inlines) {
+         markCodePages(callee.start, callee.end + 4);
+      }
+   }
+
+   static void removeBlock(const JitBlock& block);
+
+   static void
+   publishBlock(JitBlock& block)
+   {
+      auto existing = sBlockList.find(block.start);
+      if (existing != sBlockList.end()) {
+         removeBlock(existing->second);
+         sBlockList.erase(existing);
+      }
+
+      publishEntry(block.start, block.entry);
+      markBlockPages(block);
+
+      if (block.code) {
+         sHostBlocks[block.code] = block.start;
+
+         std::unique_lock<std::mutex> rangeLock(sHostRangeMutex);
+         sHostRanges[block.code] = block.code + block.codeSize;
+      }
+
+      for (auto i = block.targets.cbegin(); i != block.targets.cend(); ++i) {
+         if (i->second) {
+            publishEntry(i->first, i->second);
+         }
+      }
+
+      for (auto &exit : block.exits) {
+         sLinkSites[exit.target].push_back(exit.site);
+
+         auto target = lookupBlock(exit.target);
+         if (target) {
+            linkExitSite(exit.site, target);
+         }
+      }
+
+      auto start = block.start;
+      sBlockList.emplace(start, std::move(block));
+   }
+
+   static void
+   removeBlock(const JitBlock& block)
+   {
+      unpublishEntry(block.start);
+      if (block.code) {
+         sHostBlocks.erase(block.code);
+
+         std::unique_lock<std::mutex> rangeLock(sHostRangeMutex);
+         sHostRanges.erase(block.code);
+      }
+
+      for (auto i = block.targets.cbegin(); i != block.targets.cend(); ++i) {
+         unpublishEntry(i->first);
+      }
+
+      // The code stays around, so a return stack entry may still jump
+      //   into it, make its exits go back through the dispatcher.
+      for (auto &exit : block.exits) {
+         auto sites = sLinkSites.find(exit.target);
+         if (sites != sLinkSites.end()) {
+            auto &list = sites->second;
+            list.erase(std::remove(list.begin(), list.end(), exit.site), list.end());
+         }
+
+         unlinkExitSite(exit.site, exit.target);
+      }
+   }
+
    void clearCache()
    {
+      std::unique_lock<std::shared_timed_mutex> runtimeLock(sRuntimeMutex);
+      std::unique_lock<std::mutex> lock(sMutex);
+
       if (sRuntime) {
          delete sRuntime;
          sRuntime = nullptr;
       }
 
-      sRuntime = new asmjit::JitRuntime();
-      sBlocks.clear();
-      sSingleBlocks.clear();
-      initStubs();
-   }
+      for (auto &pagePtr : sBlockPages) {
+         auto page = pagePtr.exchange(nullptr);
+         if (page) {
+            delete page;
+         }
+      }
+
+      for (auto &pagePtr : sHotPages) {
+         auto page = pagePtr.exchange(nullptr);
+         if (page) {
+            delete page;
+         }
+      }
+
+      sRuntime = new asmjit::JitRuntime();
+      sBlockList.clear();
+      sLinkSites.clear();
+      sFailedBlocks.clear();
+      sSingleBlocks.clear();
+      sHostBlocks.clear();
+      sTierCounters.clear();
+
+      {
+         std::unique_lock<std::mutex> rangeLock(sHostRangeMutex);
+         sHostRanges.clear();
+      }
+
+      sInvalidateEpoch++;
+      sCodeGeneration++;
+      initStubs();
+
+      for (auto &bits : sCodePages) {
+         bits.store(0);
+      }
+
+      std::unique_lock<std::mutex> queueLock(sQueueMutex);
+      sQueuedBlocks.clear();
+   }
+
+   // Drops every block overlapping the range, unlinking any exits
+   //   into them so they go back through the dispatcher. The code of
+   //   dropped blocks is not freed as a guest thread may still be inside
+   //   it, suspended in a kernel call, it goes with the next clearCache.
+   void invalidate(uint32_t address, uint32_t size)
+   {
+      auto end = address + size;
+
+      if (!size) {
+         return;
+      }
+
+      // Pairs with the page marking in identBlock, either the compile
+      //   reads the new code or we see its page and discard it.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      if (!hasCodePages(address, end)) {
+         return;
+      }
+
+      // Discards compiles which are still in progress
+      sInvalidateEpoch++;
+
+      std::unique_lock<std::mutex> lock(sMutex);
+
+      for (auto i = sBlockList.begin(); i != sBlockList.end(); ) {
+         auto &block = i->second;
+
+         if (block.overlaps(address, end)) {
+            removeBlock(block);
+            i = sBlockList.erase(i);
+         } else {
+            ++i;
+         }
+      }
+
+      sFailedBlocks.erase(sFailedBlocks.lower_bound(address), sFailedBlocks.lower_bound(end));
+      sSingleBlocks.erase(sSingleBlocks.lower_bound(address), sSingleBlocks.lower_bound(end));
+
+      // The pages may still hold blocks from outside of the range
+      auto firstPage = address & ~JitPageMask;
+      auto lastPage = (end - 1) | JitPageMask;
+      clearCodePages(address, end);
+
+      for (auto &i : sBlockList) {
+         auto &block = i.second;
+
+         if (block.overlaps(firstPage, lastPage + 1)) {
+            markBlockPages(block);
+         }
+      }
+
+      gLog->debug("Invalidated JIT code in {:08x}-{:08x}", address, end);
+
+      std::unique_lock<std::mutex> queueLock(sQueueMutex);
+      sQueuedBlocks.erase(sQueuedBlocks.lower_bound(address), sQueuedBlocks.lower_bound(end));
+   }
+
+   // Must be called with sMutex held
+   static const JitBlock *
+   findHostBlock(const uint8_t *host)
+   {
+      auto itr = sHostBlocks.upper_bound(host);
+      if (itr == sHostBlocks.begin()) {
+         return nullptr;
+      }
+
+      --itr;
+
+      auto block = sBlockList.find(itr->second);
+      if (block == sBlockList.end() || host >= block->second.code + block->second.codeSize) {
+         return nullptr;
+      }
+
+      return &block->second;
+   }
+
+   static uint32_t
+   getGuestAddress(const JitBlock& block, uint32_t offset)
+   {
+      auto &addressMap = block.addressMap;
+      auto entry = std::upper_bound(addressMap.begin(), addressMap.end(), std::make_pair(offset, UINT32_MAX));
+      if (entry == addressMap.begin()) {
+         return 0;
+      }
+
+      return std::prev(entry)->second;
+   }
+
+   uint32_t findGuestAddress(const void *pc)
+   {
+      std::unique_lock<std::mutex> lock(sMutex);
+      auto host = static_cast<const uint8_t*>(pc);
+
+      auto block = findHostBlock(host);
+      if (!block) {
+         return 0;
+      }
+
+      return getGuestAddress(*block, static_cast<uint32_t>(host - block->code));
+   }
+
+   // Whether pc lies in the code of a published block, never takes sMutex
+   static bool
+   isHostCode(const void *pc)
+   {
+      std::unique_lock<std::mutex> lock(sHostRangeMutex);
+      auto host = static_cast<const uint8_t*>(pc);
+
+      auto itr = sHostRanges.upper_bound(host);
+      if (itr == sHostRanges.begin()) {
+         return false;
+      }
+
+      return host < std::prev(itr)->second;
+   }
+
+   bool findAccessSite(const void *pc, JitAccessSite& site, uint32_t& guestAddress)
+   {
+      // A fault outside JIT code may come from this thread holding sMutex,
+      //   such as identBlock reading an unmapped guest address.
+      if (!isHostCode(pc)) {
+         return false;
+      }
+
+      std::unique_lock<std::mutex> lock(sMutex);
+      auto host = static_cast<const uint8_t*>(pc);
+
+      auto block = findHostBlock(host);
+      if (!block) {
+         return false;
+      }
+
+      auto offset = static_cast<uint32_t>(host - block->code);
+      auto &sites = block->accessSites;
+      auto itr = std::lower_bound(sites.begin(), sites.end(), offset,
+                                  [](const JitAccessSite& s, uint32_t o) { return s.offset < o; });
+
+      if (itr == sites.end() || itr->offset != offset) {
+         return false;
+      }
+
+      site = *itr;
+      guestAddress = getGuestAddress(*block, offset);
+      return true;
+   }
+
+   // Guest accesses are single host instructions against membase, an
+   //   access to an unmapped page is stepped over with loads reading
+   //   zero rather than taking down the emulator.
+   static LONG CALLBACK
+   handleGuestFault(PEXCEPTION_POINTERS info)
+   {
+      auto record = info->ExceptionRecord;
+      auto context = info->ContextRecord;
+
+      if (record->ExceptionCode != EXCEPTION_ACCESS_VIOLATION || record->NumberParameters < 2) {
+         return EXCEPTION_CONTINUE_SEARCH;
+      }
+
+      auto host = static_cast<uint64_t>(record->ExceptionInformation[1]);
+      if (host < mem::base() || host - mem::base() > 0xFFFFFFFFull) {
+         return EXCEPTION_CONTINUE_SEARCH;
+      }
+
+      JitAccessSite site;
+      uint32_t cia;
+      auto pc = reinterpret_cast<const void*>(context->Rip);
+
+      if (!findAccessSite(pc, site, cia)) {
+         return EXCEPTION_CONTINUE_SEARCH;
+      }
+
+      auto address = static_cast<uint32_t>(host - mem::base());
+
+      if (site.kind == JitAccessKind::Load) {
+         gLog->error("Invalid read from {:08x} at {:08x}", address, cia);
+         context->Rax = 0;
+      } else {
+         gLog->error("Invalid write to {:08x} at {:08x}", address, cia);
+      }
+
+      context->Rip += site.length;
+      return EXCEPTION_CONTINUE_EXECUTION;
+   }
+
+   void genBlockExit(PPCEmuAssembler& a, uint32_t nia)
+   {
+      asmjit::Label exitLabel(a);
+
+      a.flushGprs();
+      genExitSite(a, nia, exitLabel);
+   }
+
+   // Emits a linkable `mov eax, nia; jmp finale` at exitLabel, the
+   //   caller has already written back any cached registers.
+   void genExitSite(PPCEmuAssembler& a, uint32_t nia, asmjit::Label& exitLabel)
+   {
+      uint8_t movEax[5] = {
+         0xB8,
+         static_cast<uint8_t>(nia), static_cast<uint8_t>(nia >> 8),
+         static_cast<uint8_t>(nia >> 16), static_cast<uint8_t>(nia >> 24)
+      };
+
+      a.align(asmjit::kAlignCode, 8);
+      a.bind(exitLabel);
+      a.embed(movEax, sizeof(movEax));
+      a.jmp(a.hostLiteral(JitRelocKind::Finale, 0, gFinaleFn));
+
+      a.exitLabels.push_back(std::make_pair(nia, exitLabel));
+   }
+
+   bool jit_b(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels);
+   bool jit_bc(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels);
+   bool jit_bcctr(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels);
+   bool jit_bclr(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels);
+
+   typedef std::vector<uint32_t> JumpTargetList;
+
+   static int
+   getGprField(Instruction instr, Field field)
+   {
+      switch (field) {
+      case Field::rA:
+         return instr.rA;
+      case Field::rB:
+         return instr.rB;
+      case Field::rD:
+         return instr.rD;
+      case Field::rS:
+         return instr.rS;
+      default:
+         return -1;
+      }
+   }
+
+   // Keep the most used guest GPRs of the block in host registers,
+   //   they are only written back at exits, fallbacks and kernel calls.
+   static void
+   allocateRegisters(PPCEmuAssembler& a, const JitBlock& block)
+   {
+      uint32_t uses[32] = { 0 };
+      uint32_t writes = 0;
+
+      std::vector<std::pair<uint32_t, uint32_t>> ranges;
+      ranges.emplace_back(block.start, block.end);
+
+      for (auto &callee : block.inlines) {
+         ranges.emplace_back(callee.start, callee.end);
+      }
+
+      for (auto &range : ranges)
+      for (auto lclCia = range.first; lclCia < range.second; lclCia += 4) {
+         auto instr = mem::read<Instruction>(lclCia);
+         auto data = gInstructionTable.decode(instr);
+
+         for (auto field : data->read) {
+            auto gpr = getGprField(instr, field);
+            if (gpr >= 0) {
+               uses[gpr]++;
+            }
+         }
+
+         for (auto field : data->write) {
+            auto gpr = getGprField(instr, field);
+            if (gpr >= 0) {
+               uses[gpr]++;
+               writes |= 1u << gpr;
+            }
+         }
+
+         if (data->id == InstructionID::lmw) {
+            writes |= ~((1u << instr.rD) - 1);
+         }
+      }
+
+      for (auto slot = 0; slot < JIT_GPR_CACHE_SIZE; ++slot) {
+         auto best = -1;
+
+         for (auto i = 0; i < 32; ++i) {
+            if (a.gprSlot[i] < 0 && uses[i] >= 2 && (best < 0 || uses[i] > uses[best])) {
+               best = i;
+            }
+         }
+
+         if (best < 0) {
+            break;
+         }
+
+         a.gprSlot[best] = slot;
+      }
+
+      a.gprCacheWrites = writes;
+   }
+
+   // Returns the CR field tested by the branch at addr when a compare
+   //   immediately before it can be handed over in registers.
+   static int
+   getFusableCrField(const JitBlock& block, const JumpLabelMap& jumpLabels, uint32_t addr)
+   {
+      if (addr >= block.end || jumpLabels.count(addr) || gDebugger.hasBreakpoint(addr)) {
+         return -1;
+      }
+
+      auto instr = mem::read<Instruction>(addr);
+      auto data = gInstructionTable.decode(instr);
+      if (!data) {
+         return -1;
+      }
+
+      if (data->id != InstructionID::bc && data->id != InstructionID::bcctr && data->id != InstructionID::bclr) {
+         return -1;
+      }
+
+      // No condition to test, or it tests summary overflow
+      if (get_bit<4>(instr.bo) || (instr.bi % 4) == 3) {
+         return -1;
+      }
+
+      return instr.bi / 4;
+   }
+
+   static void
+   promoteBlock(uint32_t start, ThreadState *state);
+
+   static void
+   hitBreakpoint(ThreadState *state)
+   {
+      gDebugControl.maybeBreak(state->cia, state, gProcessor.getCoreID());
+   }
+
+   // Only emitted for instructions which had a breakpoint when the block
+   //   was compiled, changing breakpoints invalidates the code.
+   static void
+   genBreakpoint(PPCEmuAssembler& a)
+   {
+      a.flushGprs();
+      a.materializeCia();
+      a.mov(a.zcx, a.state);
+      a.call(asmjit::Ptr(hitBreakpoint));
+      a.reloadGprs();
+   }
+
+   // Counts down the entries of a baseline block, once it runs out
+   //   the block is recompiled optimised and execution restarts there.
+   static void
+   genTierCounter(PPCEmuAssembler& a, uint32_t start)
+   {
+      asmjit::Label notHotLbl(a);
+
+      int32_t *counter;
+
+      {
+         std::unique_lock<std::mutex> lock(sTierCounterMutex);
+         sTierCounters.push_back(JIT_TIER2_THRESHOLD);
+         counter = &sTierCounters.back();
+      }
+
+      a.mov(a.zax, reinterpret_cast<uint64_t>(counter));
+      a.dec(asmjit::x86::dword_ptr(a.zax));
+      a.jnz(notHotLbl);
+
+      a.mov(a.ecx, start);
+      a.mov(a.zdx, a.state);
+      a.call(asmjit::Ptr(promoteBlock));
+      a.mov(a.eax, start);
+      a.jmp(asmjit::Ptr(gFinaleFn));
+
+      a.bind(notHotLbl);
+   }
+
+   // Emits a leaf function in place of the call to it. The return
+   //   stays in the block as long as LR still holds the return address,
+   //   which only a kernel call inside the callee could have changed.
+   static bool
+   genInlineCall(PPCEmuAssembler& a, JitBlock& block, const JitInline& callee, uint32_t cia)
+   {
+      asmjit::Label returnLbl(a);
+
+      a.mov(a.ppclr, cia + 4);
+      a.gprKnown = 0;
+
+      for (auto lclCia = callee.start; lclCia < callee.end; lclCia += 4) {
+         auto instr = mem::read<Instruction>(lclCia);
+         auto data = gInstructionTable.decode(instr);
+         auto fptr = sInstructionMap[static_cast<size_t>(data->id)];
+
+         a.genCia = lclCia;
+         block.addressMap.push_back({ static_cast<uint32_t>(a.getOffset()), lclCia });
+
+         if (gDebugger.hasBreakpoint(lclCia)) {
+            genBreakpoint(a);
+         }
+
+         a.crLiveOut = 0xFF;
+         a.crFusableField = -1;
+
+         if (!fptr || !fptr(a, instr)) {
+            gLog->debug("JIT bailed due to generation failure on inlined {}", data->name);
+            return false;
+         }
+      }
+
+      a.genCia = callee.end;
+      block.addressMap.push_back({ static_cast<uint32_t>(a.getOffset()), callee.end });
 
-   bool jit_b(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels);
-   bool jit_bc(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels);
-   bool jit_bcctr(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels);
-   bool jit_bclr(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels);
+      // The blr itself is never emitted, but a breakpoint on it still hits
+      if (gDebugger.hasBreakpoint(callee.end)) {
+         genBreakpoint(a);
+      }
 
-   typedef std::vector<uint32_t> JumpTargetList;
+      a.cmp(a.ppclr, cia + 4);
+      a.je(returnLbl);
+      a.flushGprs();
+      a.mov(a.eax, a.ppclr);
+      a.and_(a.eax, ~0x3);
+      a.jmp(a.hostLiteral(JitRelocKind::Finale, 0, gFinaleFn));
+
+      a.bind(returnLbl);
+      return true;
+   }
 
    bool gen(JitBlock& block)
    {
       PPCEmuAssembler a(sRuntime);
       bool jitFailed = false;
 
+      std::vector<uint8_t> crLiveOut;
+      std::vector<JitGprInfo> gprInfo;
+      a.gqrHint = block.gqrHint;
+      a.profile = getProfile(block.start);
+
+      if (block.tier == JitTier::Optimised) {
+         allocateRegisters(a, block);
+         analyseCrLiveness(block, crLiveOut);
+         analyseGprs(block, gprInfo);
+      } else {
+         crLiveOut.assign((block.end - block.start) / 4, 0xFF);
+         gprInfo.assign((block.end - block.start) / 4, JitGprInfo {});
+      }
+
       JumpLabelMap jumpLabels;
       for (auto i = block.targets.begin(); i != block.targets.end(); ++i) {
          if (i->first >= block.start && i->first < block.end) {
@@ -129,13 +910,22 @@ namespace jit
          }
       }
 
-      // Fix VS debug viewer...
-      for (int i = 0; i < 8; ++i) {
-         a.nop();
+      if (JIT_DEBUG_MARKERS) {
+         // Fix VS debug viewer...
+         for (int i = 0; i < 8; ++i) {
+            a.nop();
+         }
       }
 
       asmjit::Label codeStart(a);
       a.bind(codeStart);
+      genProfileEntry(a);
+
+      if (block.tier == JitTier::Baseline) {
+         genTierCounter(a, block.start);
+      }
+
+      a.reloadGprs();
 
       auto lclCia = block.start;
       while (lclCia < block.end) {
@@ -144,13 +934,38 @@ namespace jit
             a.bind(ciaLbl->second);
          }
 
-         a.mov(a.cia, lclCia);
+         a.genCia = lclCia;
+         block.addressMap.push_back({ static_cast<uint32_t>(a.getOffset()), lclCia });
+
+         if (JIT_DEBUG_MARKERS) {
+            a.mov(a.cia, lclCia);
+         }
+
+         if (gDebugger.hasBreakpoint(lclCia)) {
+            genBreakpoint(a);
+         }
 
          auto instr = mem::read<Instruction>(lclCia);
          auto data = gInstructionTable.decode(instr);
 
+         auto &gpr = gprInfo[(lclCia - block.start) / 4];
+         a.crLiveOut = crLiveOut[(lclCia - block.start) / 4];
+         a.crFusableField = getFusableCrField(block, jumpLabels, lclCia + 4);
+         a.gprKnown = gpr.known;
+         memcpy(a.gprValue, gpr.value, sizeof(a.gprValue));
+
+         auto callee = std::find_if(block.inlines.begin(), block.inlines.end(),
+                                    [lclCia](const JitInline& i) { return i.site == lclCia; });
+
          bool genSuccess = false;
-         if (data->id == InstructionID::b) {
+         if (gpr.dead) {
+            genSuccess = true;
+         } else if (gpr.constant) {
+            a.storeGprImm(gpr.dest, gpr.result);
+            genSuccess = true;
+         } else if (callee != block.inlines.end()) {
+            genSuccess = genInlineCall(a, block, *callee, lclCia);
+         } else if (data->id == InstructionID::b) {
             genSuccess = jit_b(a, instr, lclCia, jumpLabels);
          } else if (data->id == InstructionID::bc) {
             genSuccess = jit_bc(a, instr, lclCia, jumpLabels);
@@ -165,6 +980,9 @@ namespace jit
             }
          }
 
+         // A deferred compare is only ever consumed by the very next branch
+         assert(a.crPendingField < 0 || a.crPendingField == a.crFusableField);
+
          if (!genSuccess) {
             gLog->debug("JIT bailed due to generation failure on {}", data->name);
 
@@ -176,7 +994,9 @@ namespace jit
             }
          }
 
-         a.nop();
+         if (JIT_DEBUG_MARKERS) {
+            a.nop();
+         }
 
          lclCia += 4;
       }
@@ -192,9 +1012,32 @@ namespace jit
          }
       }
 
-      a.mov(a.eax, block.end);
-      a.jmp(asmjit::Ptr(gFinaleFn));
+      genBlockExit(a, block.end);
+
+      // Registers are already written back when blr jumps to these
+      for (auto &pad : a.returnPads) {
+         genExitSite(a, pad.first, pad.second);
+      }
 
+      // Entering in the middle of the block must load the cached
+      //   registers first, jumps within the block already have them.
+      JumpLabelMap entryLabels;
+      for (auto i = jumpLabels.begin(); i != jumpLabels.end(); ++i) {
+         if (a.hasCachedGprs() || a.profile) {
+            asmjit::Label entryLabel(a);
+            a.bind(entryLabel);
+            genProfileEntry(a);
+            a.reloadGprs();
+            a.jmp(i->second);
+            entryLabels[i->first] = entryLabel;
+         } else {
+            entryLabels[i->first] = i->second;
+         }
+      }
+
+      a.emitLiterals();
+
+      auto codeSize = static_cast<uint32_t>(a.getCodeSize());
       JitCode func = asmjit_cast<JitCode>(a.make());
       if (func == nullptr) {
          gLog->error("JIT failed due to asmjit make failure");
@@ -203,13 +1046,104 @@ namespace jit
 
       auto baseAddr = asmjit_cast<JitCode>(func, a.getLabelOffset(codeStart));
       block.entry = baseAddr;
-      for (auto i = jumpLabels.cbegin(); i != jumpLabels.cend(); ++i) {
+      for (auto i = entryLabels.cbegin(); i != entryLabels.cend(); ++i) {
          block.targets[i->first] = asmjit_cast<JitCode>(func, a.getLabelOffset(i->second));
       }
 
+      for (auto &exit : a.exitLabels) {
+         block.exits.push_back({ exit.first, asmjit_cast<uint8_t*>(func, a.getLabelOffset(exit.second)) });
+      }
+
+      block.code = asmjit_cast<uint8_t*>(func);
+      block.codeSize = codeSize;
+
+      block.accessSites = a.accessSites;
+
+      for (auto &literal : a.literals) {
+         block.relocs.push_back({ literal.kind, literal.index, static_cast<uint32_t>(a.getLabelOffset(literal.label)) });
+      }
+
       return true;
    }
 
+   // Returns the address of the blr ending the leaf function at start,
+   //   the body may not contain any other branch.
+   static bool
+   findLeafEnd(uint32_t start, uint32_t& end)
+   {
+      for (auto lclCia = start; lclCia < start + JIT_INLINE_MAX_INST * 4; lclCia += 4) {
+         if (lclCia == start || !(lclCia & JitPageMask)) {
+            if (!mem::valid(lclCia)) {
+               return false;
+            }
+
+            markCodePages(lclCia, lclCia + 4);
+         }
+
+         auto instr = mem::read<Instruction>(lclCia);
+         auto data = gInstructionTable.decode(instr);
+
+         if (!data) {
+            return false;
+         }
+
+         switch (data->id) {
+         case InstructionID::bclr:
+            if (get_bit<2>(instr.bo) && get_bit<4>(instr.bo) && !instr.lk) {
+               end = lclCia;
+               return true;
+            }
+
+            return false;
+         case InstructionID::b:
+         case InstructionID::bc:
+         case InstructionID::bcctr:
+            return false;
+         default:
+            if (!sInstructionMap[static_cast<size_t>(data->id)]) {
+               return false;
+            }
+         }
+      }
+
+      return false;
+   }
+
+   // Finds direct calls to small leaf functions, such as vector math
+   //   helpers or kernel call thunks, which gen can compile inline.
+   static void
+   findInlineCalls(JitBlock& block)
+   {
+      auto budget = JIT_INLINE_BUDGET;
+
+      for (auto lclCia = block.start; lclCia < block.end; lclCia += 4) {
+         auto instr = mem::read<Instruction>(lclCia);
+         auto data = gInstructionTable.decode(instr);
+
+         if (!data || data->id != InstructionID::b || !instr.lk) {
+            continue;
+         }
+
+         uint32_t target = sign_extend<26>(instr.li << 2);
+         if (!instr.aa) {
+            target += lclCia;
+         }
+
+         uint32_t end;
+         if (!findLeafEnd(target, end)) {
+            continue;
+         }
+
+         auto size = (end - target) / 4;
+         if (size > budget) {
+            break;
+         }
+
+         budget -= size;
+         block.inlines.push_back({ lclCia, target, end });
+      }
+   }
+
    bool identBlock(JitBlock& block) {
       auto fnStart = block.start;
       auto fnMax = fnStart;
@@ -219,6 +1153,11 @@ namespace jit
 
       auto lclCia = fnStart;
       while (lclCia) {
+         // Mark pages before reading them so invalidate can't miss us
+         if (lclCia == fnStart || !(lclCia & JitPageMask)) {
+            markCodePages(lclCia, lclCia + 4);
+         }
+
          auto instr = mem::read<Instruction>(lclCia);
          auto data = gInstructionTable.decode(instr);
 
@@ -326,44 +1265,279 @@ namespace jit
       for (auto i : jumpTargets) {
          block.targets[i] = nullptr;
       }
-      return true;
-   }
 
-   JitCode get(uint32_t addr) {
-      auto i = sBlocks.find(addr);
-      if (i != sBlocks.end()) {
-         return i->second;
+      if (block.tier == JitTier::Optimised) {
+         findInlineCalls(block);
       }
+      return true;
+   }
 
-      // Set it to nullptr first so we don't
-      //   try to regenerate after a failed attempt.
-      sBlocks[addr] = nullptr;
+   // Identifies and generates the block without publishing it. The caller
+   //   holds sRuntimeMutex so the runtime can't be released underneath.
+   static bool
+   buildBlock(JitBlock& block)
+   {
+      markCodePages(block.start, block.start + 4);
 
-      JitBlock block(addr);
+      // Cached code has no profiling counters or breakpoints
+      if (!getProfile(block.start) && !gDebugger.isEnabled() && restoreCachedBlock(sRuntime, block)) {
+         writePerfMap(block);
+         return true;
+      }
 
       gLog->debug("Attempting to JIT {:08x}", block.start);
 
       if (!identBlock(block)) {
-         return nullptr;
+         return false;
       }
 
       gLog->debug("Found end at {:08x}", block.end);
 
       if (!gen(block)) {
+         return false;
+      }
+
+      writePerfMap(block);
+      return true;
+   }
+
+   // Must be called with sMutex held
+   static JitCode
+   compileBlock(uint32_t addr, JitTier tier, const JitGqrHint& gqrHint)
+   {
+      // Don't try to regenerate after a failed attempt.
+      if (sFailedBlocks.count(addr)) {
          return nullptr;
       }
 
-      sBlocks[block.start] = block.entry;
-      for (auto i = block.targets.cbegin(); i != block.targets.cend(); ++i) {
-         if (i->second) {
-            sBlocks[i->first] = i->second;
+      JitBlock block(addr, tier);
+      block.gqrHint = gqrHint;
+
+      auto epoch = sInvalidateEpoch.load();
+
+      if (!buildBlock(block)) {
+         sFailedBlocks.insert(addr);
+         return nullptr;
+      }
+
+      // The guest code was rewritten while we compiled it
+      if (epoch != sInvalidateEpoch.load()) {
+         return compileBlock(addr, tier, gqrHint);
+      }
+
+      auto code = block.entry;
+      publishBlock(block);
+      return code;
+   }
+
+   bool saveCache(const std::string &path)
+   {
+      if (cpu::getJitProfileMode() != cpu::JitProfileMode::Disabled) {
+         gLog->info("Not saving JIT cache {} of profiled code", path);
+         return false;
+      }
+
+      if (gDebugger.isEnabled()) {
+         gLog->info("Not saving JIT cache {} of code compiled for the debugger", path);
+         return false;
+      }
+
+      std::unique_lock<std::mutex> lock(sMutex);
+      return writeCache(path, sBlockList);
+   }
+
+   JitCode get(uint32_t addr, const ThreadState *state) {
+      auto code = lookupBlock(addr);
+      if (code) {
+         return code;
+      }
+
+      std::shared_lock<std::shared_timed_mutex> runtimeLock(sRuntimeMutex);
+      std::unique_lock<std::mutex> lock(sMutex);
+
+      // Another core may have compiled it while we waited
+      code = lookupBlock(addr);
+      if (code) {
+         return code;
+      }
+
+      return compileBlock(addr, JitTier::Optimised, getGqrHint(state));
+   }
+
+   static void
+   compileThreadEntry()
+   {
+      while (true) {
+         CompileRequest request;
+
+         {
+            std::unique_lock<std::mutex> queueLock(sQueueMutex);
+            sQueueCondition.wait(queueLock, [] { return !sCompileQueue.empty(); });
+            request = sCompileQueue.front();
+            sCompileQueue.pop_front();
+         }
+
+         std::shared_lock<std::shared_timed_mutex> runtimeLock(sRuntimeMutex);
+         uint32_t epoch;
+
+         {
+            std::unique_lock<std::mutex> lock(sMutex);
+            auto existing = sBlockList.find(request.addr);
+
+            if (sFailedBlocks.count(request.addr)) {
+               continue;
+            }
+
+            if (request.tier == JitTier::Baseline && lookupBlock(request.addr)) {
+               continue;
+            }
+
+            if (request.tier == JitTier::Optimised
+             && existing != sBlockList.end() && existing->second.tier == JitTier::Optimised) {
+               continue;
+            }
+
+            epoch = sInvalidateEpoch.load();
+         }
+
+         JitBlock block(request.addr, request.tier);
+         block.gqrHint = request.gqrHint;
+         auto built = buildBlock(block);
+
+         {
+            std::unique_lock<std::mutex> lock(sMutex);
+
+            // The guest code changed while we were compiling it
+            if (epoch != sInvalidateEpoch.load()) {
+               std::unique_lock<std::mutex> queueLock(sQueueMutex);
+               sQueuedBlocks.erase(request.addr);
+               continue;
+            }
+
+            if (built) {
+               publishBlock(block);
+            } else if (request.tier == JitTier::Baseline) {
+               sFailedBlocks.insert(request.addr);
+            }
+         }
+
+         // Failed blocks stay in sQueuedBlocks so they are not requeued
+         if (built) {
+            std::unique_lock<std::mutex> queueLock(sQueueMutex);
+            sQueuedBlocks.erase(request.addr);
          }
       }
-      return block.entry;
+   }
+
+   static void
+   queueCompile(uint32_t addr, JitTier tier, const JitGqrHint& gqrHint)
+   {
+      {
+         std::unique_lock<std::mutex> queueLock(sQueueMutex);
+         if (!sQueuedBlocks.insert(addr).second) {
+            return;
+         }
+
+         sCompileQueue.push_back({ addr, tier, gqrHint });
+      }
+
+      sQueueCondition.notify_one();
+   }
+
+   void startCompileThreads(unsigned count)
+   {
+      for (auto i = 0u; i < count; ++i) {
+         std::thread(compileThreadEntry).detach();
+      }
+
+      sCompileThreadCount += count;
+   }
+
+   static uint32_t
+   countEntry(uint32_t addr)
+   {
+      auto &pagePtr = sHotPages[addr >> JitPageShift];
+      auto page = pagePtr.load(std::memory_order_acquire);
+
+      if (!page) {
+         auto newPage = new JitHotPage();
+         for (auto &count : newPage->counts) {
+            count.store(0, std::memory_order_relaxed);
+         }
+
+         if (pagePtr.compare_exchange_strong(page, newPage)) {
+            page = newPage;
+         } else {
+            delete newPage;
+         }
+      }
+
+      return page->counts[(addr & JitPageMask) >> 2].fetch_add(1, std::memory_order_relaxed) + 1;
+   }
+
+   // Returns the block at addr once it has been interpreted threshold
+   //   times, nullptr until then. With compile threads running the
+   //   block is queued instead and nullptr returned until published.
+   static JitCode
+   getHot(uint32_t addr, uint32_t threshold, JitTier tier, const ThreadState *state)
+   {
+      auto code = lookupBlock(addr);
+      if (code) {
+         return code;
+      }
+
+      if (threshold > 1 && countEntry(addr) < threshold) {
+         return nullptr;
+      }
+
+      if (sCompileThreadCount) {
+         queueCompile(addr, tier, getGqrHint(state));
+         return nullptr;
+      }
+
+      std::shared_lock<std::shared_timed_mutex> runtimeLock(sRuntimeMutex);
+      std::unique_lock<std::mutex> lock(sMutex);
+
+      code = lookupBlock(addr);
+      if (code) {
+         return code;
+      }
+
+      return compileBlock(addr, tier, getGqrHint(state));
+   }
+
+   // Called from a baseline block whose entry counter ran out
+   static void
+   promoteBlock(uint32_t start, ThreadState *state)
+   {
+      if (sCompileThreadCount) {
+         queueCompile(start, JitTier::Optimised, getGqrHint(state));
+         return;
+      }
+
+      std::shared_lock<std::shared_timed_mutex> runtimeLock(sRuntimeMutex);
+      std::unique_lock<std::mutex> lock(sMutex);
+
+      auto block = sBlockList.find(start);
+      if (block == sBlockList.end() || block->second.tier != JitTier::Baseline) {
+         return;
+      }
+
+      // The baseline block stays published if this fails
+      JitBlock optimised(start, JitTier::Optimised);
+      optimised.gqrHint = getGqrHint(state);
+
+      auto epoch = sInvalidateEpoch.load();
+      if (!buildBlock(optimised) || epoch != sInvalidateEpoch.load()) {
+         return;
+      }
+
+      gLog->debug("Recompiled hot block {:08x}", start);
+      publishBlock(optimised);
    }
 
    bool prepare(uint32_t addr) {
-      return get(addr) != nullptr;
+      return get(addr, nullptr) != nullptr;
    }
 
    JitCode getSingle(uint32_t addr) {
@@ -381,17 +1555,40 @@ namespace jit
          return nullptr;
       }
 
+      writePerfMap(block);
       sSingleBlocks[addr] = block.entry;
       return block.entry;
    }
 
+   // Return stack entries point into the current runtime, drop any
+   //   left from before the last clearCache or never initialised.
+   static void
+   checkReturnStack(ThreadState *state)
+   {
+      auto generation = sCodeGeneration.load();
+
+      if (state->rsbGeneration != generation) {
+         for (auto &entry : state->rsb) {
+            entry.lr = 1;
+            entry.host = nullptr;
+         }
+
+         state->rsbTop = 0;
+         state->rsbGeneration = generation;
+      }
+   }
+
    uint32_t execute(ThreadState *state, JitCode block) {
+      checkReturnStack(state);
+
+      // Don't charge the time since the fiber last ran to its last block
+      state->profileBlock = nullptr;
       return gCallFn(state, block);
    }
 
    void execute(ThreadState *state) {
       while (state->nia != cpu::CALLBACK_ADDR) {
-         JitCode jitFn = get(state->nia);
+         JitCode jitFn = get(state->nia, state);
          if (!jitFn) {
             assert(0);
          }
@@ -402,12 +1599,86 @@ namespace jit
       }
    }
 
+   // Interprets any block which is not compiled (yet)
+   static void
+   executeHot(ThreadState *state, uint32_t threshold, JitTier tier)
+   {
+      while (state->nia != cpu::CALLBACK_ADDR) {
+         JitCode jitFn = getHot(state->nia, threshold, tier, state);
+         if (!jitFn) {
+            interpreter::executeBlock(state);
+            continue;
+         }
+
+         auto newNia = execute(state, jitFn);
+         state->cia = 0;
+         state->nia = newNia;
+      }
+   }
+
    void executeSub(ThreadState *state)
    {
       auto lr = state->lr;
       state->lr = CALLBACK_ADDR;
 
-      execute(state);
+      if (sCompileThreadCount) {
+         executeHot(state, 1, JitTier::Optimised);
+      } else {
+         execute(state);
+      }
+
+      state->lr = lr;
+   }
+
+   std::vector<std::pair<uint32_t, uint32_t>> getBlockRanges(uint32_t addr)
+   {
+      std::vector<std::pair<uint32_t, uint32_t>> ranges;
+      std::unique_lock<std::mutex> lock(sMutex);
+
+      auto itr = sBlockList.upper_bound(addr);
+      if (itr == sBlockList.begin()) {
+         return ranges;
+      }
+
+      auto &block = (--itr)->second;
+      if (block.start != addr && !block.targets.count(addr)) {
+         return ranges;
+      }
+
+      ranges.emplace_back(block.start, block.end);
+
+      for (auto &callee : block.inlines) {
+         ranges.emplace_back(callee.start, callee.end + 4);
+      }
+
+      return ranges;
+   }
+
+   void executeVerifiedSub(ThreadState *state)
+   {
+      auto lr = state->lr;
+      state->lr = CALLBACK_ADDR;
+
+      while (state->nia != cpu::CALLBACK_ADDR) {
+         JitCode jitFn = get(state->nia, state);
+         if (!jitFn) {
+            assert(0);
+         }
+
+         auto newNia = verifyBlock(state, jitFn, getBlockRanges(state->nia));
+         state->cia = 0;
+         state->nia = newNia;
+      }
+
+      state->lr = lr;
+   }
+
+   void executeTieredSub(ThreadState *state)
+   {
+      auto lr = state->lr;
+      state->lr = CALLBACK_ADDR;
+
+      executeHot(state, JIT_TIER1_THRESHOLD, JitTier::Baseline);
 
       state->lr = lr;
    }
@@ -1,4 +1,5 @@
 #pragma once
+#include <string>
 #include "../cpu.h"
 
 namespace cpu
@@ -7,9 +8,23 @@ namespace jit
 {
 
 void initialise();
+void startCompileThreads(unsigned count);
 
 void clearCache();
+void invalidate(uint32_t address, uint32_t size);
 void executeSub(ThreadState *state);
+void executeTieredSub(ThreadState *state);
+
+// Runs every JIT block after interpreting it on a shadow state and logs
+//   where the two disagree.
+void executeVerifiedSub(ThreadState *state);
+
+bool loadCache(const std::string &path);
+bool saveCache(const std::string &path);
+
+void dumpProfile(unsigned count = 50);
+
+bool openPerfMap();
 
 }
 }
\ No newline at end of file
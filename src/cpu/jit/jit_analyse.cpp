@@ -0,0 +1,520 @@
+#include <algorithm>
+#include <cstring>
+#include "jit_internal.h"
+#include "jit_insreg.h"
+#include "../instructiondata.h"
+#include "../../mem/mem.h"
+#include "bitutils.h"
+
+namespace cpu
+{
+namespace jit
+{
+
+   static const uint8_t CrAllFields = 0xFF;
+
+   static uint8_t
+   crFieldBit(uint32_t field)
+   {
+      return static_cast<uint8_t>(1 << field);
+   }
+
+   static uint8_t
+   crBitField(uint32_t bit)
+   {
+      return crFieldBit(bit / 4);
+   }
+
+   struct CrFlow
+   {
+      uint8_t use = 0;
+      uint8_t def = 0;
+      bool fallthrough = true;
+      bool exits = false;
+      int target = -1;
+   };
+
+   static void
+   getBranchFlow(const JitBlock& block, Instruction instr, InstructionID id, uint32_t cia, CrFlow& flow)
+   {
+      uint32_t nia = 0;
+      auto direct = false;
+
+      if (id == InstructionID::b) {
+         nia = sign_extend<26>(instr.li << 2);
+         if (!instr.aa) {
+            nia += cia;
+         }
+
+         flow.fallthrough = false;
+         direct = !instr.lk;
+      } else if (id == InstructionID::bc) {
+         nia = sign_extend<16>(instr.bd << 2);
+         if (!instr.aa) {
+            nia += cia;
+         }
+
+         direct = true;
+      } else {
+         // bcctr / bclr
+         flow.exits = true;
+      }
+
+      if (id != InstructionID::b && !get_bit<4>(instr.bo)) {
+         flow.use |= crBitField(instr.bi);
+      }
+
+      if (direct && nia >= block.start && nia < block.end && block.targets.count(nia)) {
+         flow.target = (nia - block.start) / 4;
+      } else if (id != InstructionID::bcctr && id != InstructionID::bclr) {
+         flow.exits = true;
+      }
+   }
+
+   static void
+   getCrFlow(const JitBlock& block, Instruction instr, InstructionData *data, uint32_t cia, CrFlow& flow)
+   {
+      switch (data->id) {
+      case InstructionID::b:
+      case InstructionID::bc:
+      case InstructionID::bcctr:
+      case InstructionID::bclr:
+         getBranchFlow(block, instr, data->id, cia, flow);
+         return;
+      case InstructionID::cmp:
+      case InstructionID::cmpi:
+      case InstructionID::cmpl:
+      case InstructionID::cmpli:
+      case InstructionID::mcrxr:
+         flow.def = crFieldBit(instr.crfD);
+         return;
+      case InstructionID::mcrf:
+         flow.use = crFieldBit(instr.crfS);
+         flow.def = crFieldBit(instr.crfD);
+         return;
+      case InstructionID::crand:
+      case InstructionID::crandc:
+      case InstructionID::creqv:
+      case InstructionID::crnand:
+      case InstructionID::crnor:
+      case InstructionID::cror:
+      case InstructionID::crorc:
+      case InstructionID::crxor:
+         // Only a single bit of crbD is written, the rest of its field survives
+         flow.use = crBitField(instr.crbA) | crBitField(instr.crbB) | crBitField(instr.crbD);
+         return;
+      case InstructionID::mfcr:
+      case InstructionID::kc:
+         flow.use = CrAllFields;
+         return;
+      case InstructionID::mtcrf:
+         for (auto i = 0u; i < 8; ++i) {
+            if (instr.crm & (1 << i)) {
+               flow.def |= crFieldBit(7 - i);
+            }
+         }
+         return;
+      default:
+         break;
+      }
+
+      auto fptr = getInstructionHandler(data->id);
+      if (!fptr || fptr == &jit_fallback) {
+         // The interpreter may read any of the condition register
+         flow.use = CrAllFields;
+         return;
+      }
+
+      // Integer record forms write cr0, floating point record forms
+      //   write cr1 and are simply not treated as a definition.
+      auto writesGpr = false;
+      for (auto field : data->write) {
+         if (field == Field::rA || field == Field::rD) {
+            writesGpr = true;
+         }
+      }
+
+      for (auto field : data->flags) {
+         if ((field == Field::rc && instr.rc && writesGpr) || field == Field::ARC) {
+            flow.def = crFieldBit(0);
+         }
+      }
+   }
+
+   void analyseCrLiveness(const JitBlock& block, std::vector<uint8_t>& liveOut)
+   {
+      auto count = (block.end - block.start) / 4;
+      std::vector<CrFlow> flows(count);
+      std::vector<uint8_t> liveIn(count, 0);
+
+      for (auto i = 0u; i < count; ++i) {
+         auto cia = block.start + i * 4;
+         auto instr = mem::read<Instruction>(cia);
+         auto data = gInstructionTable.decode(instr);
+         getCrFlow(block, instr, data, cia, flows[i]);
+      }
+
+      liveOut.assign(count, 0);
+
+      // Iterate backwards until the live sets settle, backward
+      //   branches (loops) need more than one pass.
+      auto changed = true;
+      while (changed) {
+         changed = false;
+
+         for (auto i = count; i-- > 0;) {
+            auto &flow = flows[i];
+            uint8_t out = 0;
+
+            if (flow.exits) {
+               out |= CrAllFields;
+            }
+
+            if (flow.fallthrough) {
+               out |= (i + 1 < count) ? liveIn[i + 1] : CrAllFields;
+            }
+
+            if (flow.target >= 0) {
+               out |= liveIn[flow.target];
+            }
+
+            uint8_t in = flow.use | (out & ~flow.def);
+
+            if (out != liveOut[i] || in != liveIn[i]) {
+               liveOut[i] = out;
+               liveIn[i] = in;
+               changed = true;
+            }
+         }
+      }
+   }
+
+
+   static const uint32_t GprAll = 0xFFFFFFFF;
+
+   struct GprFlow
+   {
+      uint32_t use = 0;
+      uint32_t def = 0;
+
+      // Writes GPRs other than def which are not tracked
+      bool clobbers = false;
+
+      // Writing def is the only effect of the instruction
+      bool pure = false;
+   };
+
+   static bool
+   hasField(const std::vector<Field>& fields, Field field)
+   {
+      return std::find(fields.begin(), fields.end(), field) != fields.end();
+   }
+
+   static uint32_t
+   getGprMask(Instruction instr, const std::vector<Field>& fields)
+   {
+      uint32_t mask = 0;
+
+      for (auto field : fields) {
+         switch (field) {
+         case Field::rA:
+            mask |= 1u << instr.rA;
+            break;
+         case Field::rB:
+            mask |= 1u << instr.rB;
+            break;
+         case Field::rD:
+            mask |= 1u << instr.rD;
+            break;
+         case Field::rS:
+            mask |= 1u << instr.rS;
+            break;
+         default:
+            break;
+         }
+      }
+
+      return mask;
+   }
+
+   static bool
+   isPureGprOp(Instruction instr, InstructionData *data)
+   {
+      switch (data->id) {
+      case InstructionID::add:
+      case InstructionID::addi:
+      case InstructionID::addis:
+      case InstructionID::and_:
+      case InstructionID::andc:
+      case InstructionID::extsb:
+      case InstructionID::extsh:
+      case InstructionID::mulli:
+      case InstructionID::neg:
+      case InstructionID::nor:
+      case InstructionID::or_:
+      case InstructionID::orc:
+      case InstructionID::ori:
+      case InstructionID::oris:
+      case InstructionID::rlwinm:
+      case InstructionID::subf:
+      case InstructionID::xor_:
+      case InstructionID::xori:
+      case InstructionID::xoris:
+         break;
+      default:
+         return false;
+      }
+
+      // Record and overflow forms also write CR and XER
+      if (hasField(data->flags, Field::rc) && instr.rc) {
+         return false;
+      }
+
+      if (hasField(data->flags, Field::oe) && instr.oe) {
+         return false;
+      }
+
+      return true;
+   }
+
+   static void
+   getGprFlow(Instruction instr, InstructionData *data, GprFlow& flow)
+   {
+      switch (data->id) {
+      case InstructionID::b:
+      case InstructionID::bc:
+      case InstructionID::bcctr:
+      case InstructionID::bclr:
+         return;
+      case InstructionID::kc:
+      case InstructionID::lmw:
+      case InstructionID::lswi:
+      case InstructionID::lswx:
+      case InstructionID::stmw:
+      case InstructionID::stswi:
+      case InstructionID::stswx:
+         flow.use = GprAll;
+         flow.clobbers = true;
+         return;
+      default:
+         break;
+      }
+
+      auto fptr = getInstructionHandler(data->id);
+      if (!fptr || fptr == &jit_fallback) {
+         flow.use = GprAll;
+         flow.clobbers = true;
+         return;
+      }
+
+      flow.use = getGprMask(instr, data->read);
+      flow.def = getGprMask(instr, data->write);
+      flow.pure = isPureGprOp(instr, data);
+   }
+
+   // Evaluates a pure instruction whose inputs are all known
+   static bool
+   evalConstant(Instruction instr, InstructionData *data, const JitGprInfo& in, uint32_t& dest, uint32_t& result)
+   {
+      auto isKnown = [&](uint32_t gpr) { return !!(in.known & (1u << gpr)); };
+      auto rA = in.value[instr.rA];
+      auto rB = in.value[instr.rB];
+      auto rS = in.value[instr.rS];
+      auto simm = static_cast<uint32_t>(sign_extend<16, int32_t>(instr.simm));
+
+      switch (data->id) {
+      case InstructionID::addi:
+      case InstructionID::addis:
+         if (instr.rA && !isKnown(instr.rA)) {
+            return false;
+         }
+
+         dest = instr.rD;
+         result = (instr.rA ? rA : 0) + (data->id == InstructionID::addis ? simm << 16 : simm);
+         return true;
+      case InstructionID::add:
+      case InstructionID::subf:
+         if (!isKnown(instr.rA) || !isKnown(instr.rB)) {
+            return false;
+         }
+
+         dest = instr.rD;
+         result = (data->id == InstructionID::add) ? rA + rB : rB - rA;
+         return true;
+      case InstructionID::mulli:
+      case InstructionID::neg:
+         if (!isKnown(instr.rA)) {
+            return false;
+         }
+
+         dest = instr.rD;
+         result = (data->id == InstructionID::mulli) ? rA * simm : 0 - rA;
+         return true;
+      case InstructionID::ori:
+      case InstructionID::oris:
+      case InstructionID::xori:
+      case InstructionID::xoris:
+      case InstructionID::extsb:
+      case InstructionID::extsh:
+      case InstructionID::rlwinm:
+         if (!isKnown(instr.rS)) {
+            return false;
+         }
+
+         dest = instr.rA;
+
+         if (data->id == InstructionID::ori) {
+            result = rS | instr.uimm;
+         } else if (data->id == InstructionID::oris) {
+            result = rS | (instr.uimm << 16);
+         } else if (data->id == InstructionID::xori) {
+            result = rS ^ instr.uimm;
+         } else if (data->id == InstructionID::xoris) {
+            result = rS ^ (instr.uimm << 16);
+         } else if (data->id == InstructionID::extsb) {
+            result = static_cast<uint32_t>(sign_extend<8, int32_t>(rS & 0xFF));
+         } else if (data->id == InstructionID::extsh) {
+            result = static_cast<uint32_t>(sign_extend<16, int32_t>(rS & 0xFFFF));
+         } else {
+            auto n = instr.sh;
+            auto rotated = n ? ((rS << n) | (rS >> (32 - n))) : rS;
+            result = rotated & make_ppc_bitmask(instr.mb, instr.me);
+         }
+
+         return true;
+      case InstructionID::and_:
+      case InstructionID::andc:
+      case InstructionID::nor:
+      case InstructionID::or_:
+      case InstructionID::orc:
+      case InstructionID::xor_:
+         if (!isKnown(instr.rS) || !isKnown(instr.rB)) {
+            return false;
+         }
+
+         dest = instr.rA;
+
+         if (data->id == InstructionID::and_) {
+            result = rS & rB;
+         } else if (data->id == InstructionID::andc) {
+            result = rS & ~rB;
+         } else if (data->id == InstructionID::nor) {
+            result = ~(rS | rB);
+         } else if (data->id == InstructionID::or_) {
+            result = rS | rB;
+         } else if (data->id == InstructionID::orc) {
+            result = rS | ~rB;
+         } else {
+            result = rS ^ rB;
+         }
+
+         return true;
+      default:
+         return false;
+      }
+   }
+
+   void analyseGprs(const JitBlock& block, std::vector<JitGprInfo>& info)
+   {
+      auto count = (block.end - block.start) / 4;
+      std::vector<InstructionData*> datas(count);
+      std::vector<Instruction> instrs(count);
+      std::vector<GprFlow> flows(count);
+      std::vector<CrFlow> branches(count);
+
+      info.assign(count, JitGprInfo {});
+
+      for (auto i = 0u; i < count; ++i) {
+         auto cia = block.start + i * 4;
+         instrs[i] = mem::read<Instruction>(cia);
+         datas[i] = gInstructionTable.decode(instrs[i]);
+         getGprFlow(instrs[i], datas[i], flows[i]);
+
+         switch (datas[i]->id) {
+         case InstructionID::b:
+         case InstructionID::bc:
+         case InstructionID::bcctr:
+         case InstructionID::bclr:
+            getBranchFlow(block, instrs[i], datas[i]->id, cia, branches[i]);
+            break;
+         default:
+            break;
+         }
+      }
+
+      // Forward over straight line code, anything entering from a
+      //   branch or from outside the block starts with nothing known.
+      JitGprInfo state;
+
+      for (auto i = 0u; i < count; ++i) {
+         auto cia = block.start + i * 4;
+         auto &flow = flows[i];
+
+         if (block.targets.count(cia)) {
+            state.known = 0;
+         }
+
+         info[i].known = state.known;
+         memcpy(info[i].value, state.value, sizeof(state.value));
+
+         uint32_t dest, result;
+         if (flow.pure && evalConstant(instrs[i], datas[i], state, dest, result)) {
+            info[i].constant = true;
+            info[i].dest = dest;
+            info[i].result = result;
+            state.known |= 1u << dest;
+            state.value[dest] = result;
+         } else if (flow.clobbers) {
+            state.known = 0;
+         } else {
+            state.known &= ~flow.def;
+         }
+
+         // Calls come back through a target, inlined or not
+         if (datas[i]->id == InstructionID::b && instrs[i].lk) {
+            state.known = 0;
+         }
+      }
+
+      // Backward liveness, as for the condition register
+      std::vector<uint32_t> liveIn(count, 0);
+      std::vector<uint32_t> liveOut(count, 0);
+
+      auto changed = true;
+      while (changed) {
+         changed = false;
+
+         for (auto i = count; i-- > 0;) {
+            auto &branch = branches[i];
+            uint32_t out = 0;
+
+            if (branch.exits) {
+               out |= GprAll;
+            }
+
+            if (branch.fallthrough) {
+               out |= (i + 1 < count) ? liveIn[i + 1] : GprAll;
+            }
+
+            if (branch.target >= 0) {
+               out |= liveIn[branch.target];
+            }
+
+            uint32_t in = flows[i].use | (out & ~flows[i].def);
+
+            if (out != liveOut[i] || in != liveIn[i]) {
+               liveOut[i] = out;
+               liveIn[i] = in;
+               changed = true;
+            }
+         }
+      }
+
+      for (auto i = 0u; i < count; ++i) {
+         auto &flow = flows[i];
+         info[i].dead = flow.pure && flow.def && !(flow.def & liveOut[i]);
+      }
+   }
+
+}
+}
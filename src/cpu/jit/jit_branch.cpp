@@ -21,6 +21,52 @@ namespace jit
       BcBranchCTR = 1 << 3
    };
 
+   static_assert(sizeof(rsb_entry_t) == 16, "Return stack is indexed with a shift by 4");
+
+   // Pushes the return address of a call along with the exit site
+   //   which continues from it, blr jumps straight there when LR
+   //   still matches the entry on top.
+   static void
+   genReturnPush(PPCEmuAssembler& a, uint32_t cia)
+   {
+      asmjit::Label padLabel(a);
+      a.returnPads.push_back({ cia + 4, padLabel });
+
+      a.mov(a.eax, a.ppcrsbTop);
+      a.inc(a.eax);
+      a.and_(a.eax, ReturnStackSize - 1);
+      a.mov(a.ppcrsbTop, a.eax);
+      a.shl(a.eax, 4);
+      a.lea(a.zcx, a.ppcrsb);
+      a.add(a.zcx, a.zax);
+      a.mov(asmjit::x86::dword_ptr(a.zcx, offsetof(rsb_entry_t, lr)), cia + 4);
+      a.lea(a.zax, asmjit::x86::ptr(padLabel));
+      a.mov(asmjit::x86::qword_ptr(a.zcx, offsetof(rsb_entry_t, host)), a.zax);
+   }
+
+   // Jumps to the predicted return when r8d matches the top of the
+   //   return stack, otherwise falls through to the dispatcher exit.
+   static void
+   genReturnPredict(PPCEmuAssembler& a)
+   {
+      asmjit::Label missLbl(a);
+
+      a.mov(a.eax, a.ppcrsbTop);
+      a.mov(a.ecx, a.eax);
+      a.shl(a.ecx, 4);
+      a.lea(a.zdx, a.ppcrsb);
+      a.add(a.zdx, a.zcx);
+      a.cmp(a.r8d, asmjit::x86::dword_ptr(a.zdx, offsetof(rsb_entry_t, lr)));
+      a.jne(missLbl);
+
+      a.dec(a.eax);
+      a.and_(a.eax, ReturnStackSize - 1);
+      a.mov(a.ppcrsbTop, a.eax);
+      a.jmp(asmjit::x86::qword_ptr(a.zdx, offsetof(rsb_entry_t, host)));
+
+      a.bind(missLbl);
+   }
+
    bool jit_b(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels)
    {
       uint32_t nia = sign_extend<26>(instr.li << 2);
@@ -31,9 +77,9 @@ namespace jit
       if (instr.lk) {
          a.mov(a.eax, cia + 4u);
          a.mov(a.ppclr, a.eax);
+         genReturnPush(a, cia);
 
-         a.mov(a.eax, nia);
-         a.jmp(asmjit::Ptr(cpu::jit::gFinaleFn));
+         genBlockExit(a, nia);
          return true;
       }
 
@@ -41,13 +87,68 @@ namespace jit
       if (i != jumpLabels.end()) {
          a.jmp(i->second);
       } else {
-         a.mov(a.eax, nia);
-         a.jmp(asmjit::Ptr(cpu::jit::gFinaleFn));
+         genBlockExit(a, nia);
       }
 
       return true;
    }
 
+   // Tests a compare deferred by the previous instruction directly
+   //   instead of reading the bit back from the condition register.
+   static void
+   genDeferredCondition(PPCEmuAssembler& a, Instruction instr, asmjit::Label& doCondFailLbl)
+   {
+      auto isSigned = a.crPendingSigned;
+      auto branchIfSet = get_bit<CondValue>(instr.bo);
+
+      a.cmp(a.r10d, a.r11d);
+
+      switch (instr.bi % 4) {
+      case 0: // Negative
+         if (branchIfSet) {
+            if (isSigned) {
+               a.jge(doCondFailLbl);
+            } else {
+               a.jae(doCondFailLbl);
+            }
+         } else {
+            if (isSigned) {
+               a.jl(doCondFailLbl);
+            } else {
+               a.jb(doCondFailLbl);
+            }
+         }
+         break;
+      case 1: // Positive
+         if (branchIfSet) {
+            if (isSigned) {
+               a.jle(doCondFailLbl);
+            } else {
+               a.jbe(doCondFailLbl);
+            }
+         } else {
+            if (isSigned) {
+               a.jg(doCondFailLbl);
+            } else {
+               a.ja(doCondFailLbl);
+            }
+         }
+         break;
+      case 2: // Zero
+         if (branchIfSet) {
+            a.jne(doCondFailLbl);
+         } else {
+            a.je(doCondFailLbl);
+         }
+         break;
+      default:
+         // Summary overflow is never deferred
+         assert(0);
+      }
+
+      a.crPendingField = -1;
+   }
+
    template<unsigned flags>
    static bool
       bcGeneric(PPCEmuAssembler& a, Instruction instr, uint32_t cia, const JumpLabelMap& jumpLabels)
@@ -55,6 +156,12 @@ namespace jit
       uint32_t bo = instr.bo;
       asmjit::Label doCondFailLbl(a);
 
+      // A deferred compare still has to reach the condition
+      //   register if anything after this branch reads it.
+      if (a.crPendingField >= 0 && a.isCrFieldLive(a.crPendingField)) {
+         genCrFieldUpdate(a, a.crPendingField, a.crPendingSigned);
+      }
+
       if (flags & BcCheckCtr) {
          if (!get_bit<NoCheckCtr>(bo)) {
             //state->ctr--;
@@ -78,42 +185,58 @@ namespace jit
             //auto crv = get_bit<CondValue>(bo);
             //cond_ok = (crb == crv);
 
-            a.mov(a.eax, a.ppccr);
-            a.and_(a.eax, 1 << (31 - instr.bi));
-            a.cmp(a.eax, 0);
-
-            if (get_bit<CondValue>(bo)) {
-               a.je(doCondFailLbl);
+            if (a.crPendingField == static_cast<int>(instr.bi / 4)) {
+               genDeferredCondition(a, instr, doCondFailLbl);
             } else {
-               a.jne(doCondFailLbl);
+               a.mov(a.eax, a.ppccr);
+               a.and_(a.eax, 1 << (31 - instr.bi));
+               a.cmp(a.eax, 0);
+
+               if (get_bit<CondValue>(bo)) {
+                  a.je(doCondFailLbl);
+               } else {
+                  a.jne(doCondFailLbl);
+               }
             }
          }
       }
 
+      // blrl has to read LR before linking overwrites it
+      if (flags & BcBranchLR) {
+         a.mov(a.r8d, a.ppclr);
+         a.and_(a.r8d, ~0x3);
+      }
+
       if (instr.lk) {
          a.mov(a.eax, cia + 4);
          a.mov(a.ppclr, a.eax);
+         genReturnPush(a, cia);
       }
 
       // Make sure no JMP related instructions end up above
       //   this if-block as we use a JMP instruction with
       //   early exit in the else block...
       if (flags & BcBranchCTR) {
+         a.flushGprs();
          a.mov(a.eax, a.ppcctr);
          a.and_(a.eax, ~0x3);
-         a.jmp(asmjit::Ptr(cpu::jit::gFinaleFn));
+         a.jmp(a.hostLiteral(JitRelocKind::Finale, 0, gFinaleFn));
       } else if (flags & BcBranchLR) {
-         a.mov(a.eax, a.ppclr);
-         a.and_(a.eax, ~0x3);
-         a.jmp(asmjit::Ptr(cpu::jit::gFinaleFn));
+         a.flushGprs();
+
+         if (!instr.lk) {
+            genReturnPredict(a);
+         }
+
+         a.mov(a.eax, a.r8d);
+         a.jmp(a.hostLiteral(JitRelocKind::Finale, 0, gFinaleFn));
       } else {
          uint32_t nia = cia + sign_extend<16>(instr.bd << 2);
          auto i = jumpLabels.find(nia);
          if (i != jumpLabels.end()) {
             a.jmp(i->second);
          } else {
-            a.mov(a.eax, nia);
-            a.jmp(asmjit::Ptr(cpu::jit::gFinaleFn));
+            genBlockExit(a, nia);
          }
       }
 
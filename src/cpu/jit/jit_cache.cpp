@@ -0,0 +1,321 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <vector>
+#include <Windows.h>
+#include "jit.h"
+#include "jit_internal.h"
+#include "../interpreter/interpreter_insreg.h"
+#include "../../mem/mem.h"
+#include "crc32.h"
+#include "log.h"
+
+namespace cpu
+{
+namespace jit
+{
+
+   static const uint32_t JitCacheMagic = 0x434A5557; // "WUJC"
+   static const uint32_t JitCacheVersion = 6;
+
+   struct CachedBlock
+   {
+      uint32_t start;
+      uint32_t end;
+      uint32_t guestHash;
+      uint32_t entryOffset;
+      std::vector<std::pair<uint32_t, uint32_t>> targets;
+      std::vector<std::pair<uint32_t, uint32_t>> exits;
+      std::vector<JitReloc> relocs;
+      std::vector<std::pair<uint32_t, uint32_t>> addressMap;
+      std::vector<JitInline> inlines;
+      std::vector<JitAccessSite> accessSites;
+      std::vector<uint8_t> code;
+   };
+
+   // Only written by loadCache before any code runs
+   static std::map<uint32_t, CachedBlock> sCachedBlocks;
+
+   // The generated code depends on every part of the emulator, from
+   //   ThreadState layout to instruction ids, so key it on the binary.
+   static uint32_t
+   getBuildId()
+   {
+      static std::once_flag once;
+      static uint32_t buildId = 0;
+
+      std::call_once(once, [] {
+         char path[MAX_PATH];
+         if (!GetModuleFileNameA(nullptr, path, MAX_PATH)) {
+            return;
+         }
+
+         std::ifstream file { path, std::ifstream::in | std::ifstream::binary };
+         std::vector<char> data { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+         buildId = crc32(data.data(), data.size());
+      });
+
+      return buildId;
+   }
+
+   // Covers the inlined callees too, as the code depends on them
+   static uint32_t
+   getGuestHash(uint32_t start, uint32_t end, const std::vector<JitInline> &inlines)
+   {
+      auto hash = crc32(mem::translate(start), end - start);
+
+      for (auto &callee : inlines) {
+         hash = hash * 31 + crc32(mem::translate(callee.start), callee.end + 4 - callee.start);
+      }
+
+      return hash;
+   }
+
+   template<typename Type>
+   static void
+   writeValue(std::ofstream &file, const Type &value)
+   {
+      file.write(reinterpret_cast<const char*>(&value), sizeof(Type));
+   }
+
+   template<typename Type>
+   static void
+   writeVector(std::ofstream &file, const std::vector<Type> &values)
+   {
+      writeValue(file, static_cast<uint32_t>(values.size()));
+      file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(Type));
+   }
+
+   template<typename Type>
+   static bool
+   readValue(std::ifstream &file, Type &value)
+   {
+      return !!file.read(reinterpret_cast<char*>(&value), sizeof(Type));
+   }
+
+   template<typename Type>
+   static bool
+   readVector(std::ifstream &file, std::vector<Type> &values)
+   {
+      uint32_t size;
+      if (!readValue(file, size)) {
+         return false;
+      }
+
+      values.resize(size);
+      return !!file.read(reinterpret_cast<char*>(values.data()), size * sizeof(Type));
+   }
+
+   static uint64_t
+   resolveReloc(const JitReloc &reloc)
+   {
+      switch (reloc.kind) {
+      case JitRelocKind::Finale:
+         return reinterpret_cast<uint64_t>(gFinaleFn);
+      case JitRelocKind::InterpreterHandler:
+         if (reloc.index >= static_cast<uint32_t>(InstructionID::InstructionCount)) {
+            return 0;
+         }
+
+         return reinterpret_cast<uint64_t>(interpreter::getInstructionHandler(static_cast<InstructionID>(reloc.index)));
+      case JitRelocKind::KernelCallFn:
+      case JitRelocKind::KernelCallData:
+      {
+         auto kc = cpu::getKernelCall(reloc.index);
+         if (!kc) {
+            return 0;
+         }
+
+         if (reloc.kind == JitRelocKind::KernelCallFn) {
+            return reinterpret_cast<uint64_t>(kc->first);
+         } else {
+            return reinterpret_cast<uint64_t>(kc->second);
+         }
+      }
+      default:
+         return 0;
+      }
+   }
+
+   bool loadCache(const std::string &path)
+   {
+      std::ifstream file { path, std::ifstream::in | std::ifstream::binary };
+      uint32_t magic, version, buildId, fpscrMode, hostFeatures, count;
+
+      if (!file.is_open()) {
+         return false;
+      }
+
+      if (!readValue(file, magic) || !readValue(file, version) || !readValue(file, buildId)
+       || !readValue(file, fpscrMode) || !readValue(file, hostFeatures) || !readValue(file, count)) {
+         return false;
+      }
+
+      if (magic != JitCacheMagic || version != JitCacheVersion || buildId != getBuildId()) {
+         gLog->info("Ignoring JIT cache {} from a different build", path);
+         return false;
+      }
+
+      if (fpscrMode != static_cast<uint32_t>(cpu::getJitFpscrMode())) {
+         gLog->info("Ignoring JIT cache {} generated with a different FPSCR mode", path);
+         return false;
+      }
+
+      if (hostFeatures != getHostFeatures().bits()) {
+         gLog->info("Ignoring JIT cache {} generated for a different host CPU", path);
+         return false;
+      }
+
+      for (auto i = 0u; i < count; ++i) {
+         CachedBlock block;
+
+         if (!readValue(file, block.start) || !readValue(file, block.end)
+          || !readValue(file, block.guestHash) || !readValue(file, block.entryOffset)
+          || !readVector(file, block.targets) || !readVector(file, block.exits)
+          || !readVector(file, block.relocs) || !readVector(file, block.addressMap)
+          || !readVector(file, block.inlines) || !readVector(file, block.accessSites)
+          || !readVector(file, block.code)) {
+            gLog->error("Truncated JIT cache {}", path);
+            sCachedBlocks.clear();
+            return false;
+         }
+
+         auto start = block.start;
+         sCachedBlocks.emplace(start, std::move(block));
+      }
+
+      gLog->info("Loaded {} blocks from JIT cache {}", sCachedBlocks.size(), path);
+      return true;
+   }
+
+   bool writeCache(const std::string &path, const std::map<uint32_t, JitBlock>& blocks)
+   {
+      std::ofstream file { path, std::ofstream::out | std::ofstream::binary };
+      uint32_t count = 0;
+
+      if (!file.is_open()) {
+         gLog->error("Could not open JIT cache {} for writing", path);
+         return false;
+      }
+
+      for (auto &i : blocks) {
+         if (i.second.tier == JitTier::Optimised && i.second.code) {
+            count++;
+         }
+      }
+
+      writeValue(file, JitCacheMagic);
+      writeValue(file, JitCacheVersion);
+      writeValue(file, getBuildId());
+      writeValue(file, static_cast<uint32_t>(cpu::getJitFpscrMode()));
+      writeValue(file, getHostFeatures().bits());
+      writeValue(file, count);
+
+      for (auto &i : blocks) {
+         auto &block = i.second;
+
+         if (block.tier != JitTier::Optimised || !block.code) {
+            continue;
+         }
+
+         std::vector<std::pair<uint32_t, uint32_t>> targets;
+         std::vector<std::pair<uint32_t, uint32_t>> exits;
+         std::vector<uint8_t> code { block.code, block.code + block.codeSize };
+
+         for (auto &target : block.targets) {
+            if (!target.second) {
+               continue;
+            }
+
+            targets.emplace_back(target.first, static_cast<uint32_t>(reinterpret_cast<uint8_t*>(target.second) - block.code));
+         }
+
+         // Exits may currently be linked to other blocks, store them unlinked
+         for (auto &exit : block.exits) {
+            auto offset = static_cast<uint32_t>(exit.site - block.code);
+            code[offset] = 0xB8;
+            memcpy(&code[offset + 1], &exit.target, sizeof(uint32_t));
+            exits.emplace_back(exit.target, offset);
+         }
+
+         writeValue(file, block.start);
+         writeValue(file, block.end);
+         writeValue(file, getGuestHash(block.start, block.end, block.inlines));
+         writeValue(file, static_cast<uint32_t>(reinterpret_cast<uint8_t*>(block.entry) - block.code));
+         writeVector(file, targets);
+         writeVector(file, exits);
+         writeVector(file, block.relocs);
+         writeVector(file, block.addressMap);
+         writeVector(file, block.inlines);
+         writeVector(file, block.accessSites);
+         writeVector(file, code);
+      }
+
+      gLog->info("Saved {} blocks to JIT cache {}", count, path);
+      return !!file;
+   }
+
+   bool restoreCachedBlock(asmjit::Runtime *runtime, JitBlock& block)
+   {
+      auto itr = sCachedBlocks.find(block.start);
+      if (itr == sCachedBlocks.end()) {
+         return false;
+      }
+
+      auto &cached = itr->second;
+      for (auto &callee : cached.inlines) {
+         if (!mem::valid(callee.start) || !mem::valid(callee.end)) {
+            return false;
+         }
+      }
+
+      if (getGuestHash(cached.start, cached.end, cached.inlines) != cached.guestHash) {
+         return false;
+      }
+
+      std::vector<uint64_t> values;
+      for (auto &reloc : cached.relocs) {
+         auto value = resolveReloc(reloc);
+         if (!value) {
+            return false;
+         }
+
+         values.push_back(value);
+      }
+
+      PPCEmuAssembler a(runtime);
+      a.embed(cached.code.data(), static_cast<uint32_t>(cached.code.size()));
+
+      auto code = asmjit_cast<uint8_t*>(a.make());
+      if (!code) {
+         return false;
+      }
+
+      for (auto i = 0u; i < cached.relocs.size(); ++i) {
+         memcpy(code + cached.relocs[i].offset, &values[i], sizeof(uint64_t));
+      }
+
+      block.end = cached.end;
+      block.tier = JitTier::Optimised;
+      block.entry = code + cached.entryOffset;
+      block.code = code;
+      block.codeSize = static_cast<uint32_t>(cached.code.size());
+      block.relocs = cached.relocs;
+      block.addressMap = cached.addressMap;
+      block.inlines = cached.inlines;
+      block.accessSites = cached.accessSites;
+
+      for (auto &target : cached.targets) {
+         block.targets[target.first] = code + target.second;
+      }
+
+      for (auto &exit : cached.exits) {
+         block.exits.push_back({ exit.first, code + exit.second });
+      }
+
+      return true;
+   }
+
+}
+}
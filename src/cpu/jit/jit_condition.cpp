@@ -40,11 +40,9 @@ namespace jit
       CmpImmediate = 1 << 0, // b = imm
    };
 
-   template<typename Type, unsigned flags = 0>
-   static bool
-      cmpGeneric(PPCEmuAssembler& a, Instruction instr)
+   void genCrFieldUpdate(PPCEmuAssembler& a, uint32_t crfD, bool isSigned)
    {
-      uint32_t crshift = (7 - instr.crfD) * 4;
+      uint32_t crshift = (7 - crfD) * 4;
 
       // Load CRF
       a.mov(a.edx, a.ppccr);
@@ -58,31 +56,19 @@ namespace jit
       a.mov(a.eax, a.ppcxer);
       a.and_(a.eax, XERegisterBits::StickyOV);
       a.shr(a.eax, XERegisterBits::StickyOVShift);
-      a.shl(a.eax, ConditionRegisterFlag::SummaryOverflowShift << crshift);
+      a.shl(a.eax, crshift + ConditionRegisterFlag::SummaryOverflowShift);
       a.or_(a.edx, a.eax);
 
       // Perform Comparison
-      a.mov(a.eax, a.ppcgpr[instr.rA]);
-
-      if (flags & CmpImmediate) {
-         if (std::is_signed<Type>::value) {
-            a.mov(a.ecx, sign_extend<16>(instr.simm));
-         } else {
-            a.mov(a.ecx, instr.uimm);
-         }
-      } else {
-         a.mov(a.ecx, a.ppcgpr[instr.rB]);
-      }
-
-      a.cmp(a.eax, a.ecx);
+      a.cmp(a.r10d, a.r11d);
       a.mov(a.r8d, 0);
-      if (std::is_unsigned<Type>::value) {
+      if (!isSigned) {
          a.seta(a.r8d.r8());
       } else {
          a.setg(a.r8d.r8());
       }
       a.mov(a.r9d, 0);
-      if (std::is_unsigned<Type>::value) {
+      if (!isSigned) {
          a.setb(a.r9d.r8());
       } else {
          a.setl(a.r9d.r8());
@@ -102,7 +88,37 @@ namespace jit
       a.or_(a.edx, a.ecx);
 
       a.mov(a.ppccr, a.edx);
+   }
+
+   template<typename Type, unsigned flags = 0>
+   static bool
+      cmpGeneric(PPCEmuAssembler& a, Instruction instr)
+   {
+      // Nothing reads this field before it is overwritten
+      if (!a.isCrFieldLive(instr.crfD)) {
+         return true;
+      }
+
+      a.loadGpr(a.r10d, instr.rA);
+
+      if (flags & CmpImmediate) {
+         if (std::is_signed<Type>::value) {
+            a.mov(a.r11d, sign_extend<16>(instr.simm));
+         } else {
+            a.mov(a.r11d, instr.uimm);
+         }
+      } else {
+         a.loadGpr(a.r11d, instr.rB);
+      }
+
+      // Let the following branch test the operands directly
+      if (a.crFusableField == static_cast<int>(instr.crfD)) {
+         a.crPendingField = instr.crfD;
+         a.crPendingSigned = std::is_signed<Type>::value;
+         return true;
+      }
 
+      genCrFieldUpdate(a, instr.crfD, std::is_signed<Type>::value);
       return true;
    }
 
@@ -295,7 +311,7 @@ namespace jit
       mfcr(PPCEmuAssembler& a, Instruction instr)
    {
       a.mov(a.eax, a.ppccr);
-      a.mov(a.ppcgpr[instr.rD], a.eax);
+      a.storeGpr(instr.rD, a.eax);
       return true;
    }
 
@@ -311,7 +327,7 @@ namespace jit
          }
       }
 
-      a.mov(a.eax, a.ppcgpr[instr.rS]);
+      a.loadGpr(a.eax, instr.rS);
       a.and_(a.eax, mask);
       a.mov(a.ecx, a.ppccr);
       a.and_(a.ecx, ~mask);
@@ -17,9 +17,17 @@ namespace jit
 
       //printf("JIT Fallback for `%s`\n", data->name);
 
+      if (a.profile) {
+         a.mov(a.zcx, reinterpret_cast<uint64_t>(a.profile));
+         a.inc(asmjit::x86::qword_ptr(a.zcx, offsetof(JitProfile, fallbacks)));
+      }
+
+      a.flushGprs();
+      a.materializeCia();
       a.mov(a.zcx, a.state);
       a.mov(a.edx, (uint32_t)instr);
-      a.call(asmjit::Ptr(fptr));
+      a.call(a.hostLiteral(JitRelocKind::InterpreterHandler, static_cast<uint32_t>(data->id), reinterpret_cast<const void*>(fptr)));
+      a.reloadGprs();
 
       return true;
    }
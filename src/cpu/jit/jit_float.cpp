@@ -6,108 +6,364 @@ namespace cpu
 {
 namespace jit
 {
-	alignas(16) static const u64 psAbsMask[2] = { 0x7FFFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFFFFULL };
-	alignas(16) static const u64 psSignBits[2] = { 0x8000000000000000ULL, 0x0000000000000000ULL };
-	alignas(16) static const u64 psGeneratedQNaN[2] = { 0x7FF8000000000000ULL, 0x7FF8000000000000ULL };
-	alignas(16) static const double half_qnan_and_s32_max[2] = { 0x7FFFFFFF, -0x80000 };
 
+   bool isFastFpscr()
+   {
+      return cpu::getJitFpscrMode() == JitFpscrMode::Fast;
+   }
+
+   // cr1 = fpscr.cr1
    void
       updateFloatConditionRegister(PPCEmuAssembler& a, const asmjit::X86GpReg& tmp, const asmjit::X86GpReg& tmp2)
    {
-      //state->cr.cr1 = state->fpscr.cr1;
-      assert(0);
+      a.mov(tmp.r32(), a.ppcfpscr);
+      a.shr(tmp.r32(), 4);
+      a.and_(tmp.r32(), 0x0F000000);
+      a.mov(tmp2.r32(), a.ppccr);
+      a.and_(tmp2.r32(), ~0x0F000000);
+      a.or_(tmp2.r32(), tmp.r32());
+      a.mov(a.ppccr, tmp2.r32());
+   }
+
+   static void
+   loadDouble(PPCEmuAssembler& a, const asmjit::X86XmmReg& dst, double value)
+   {
+      a.mov(a.zax, bit_cast<uint64_t>(value));
+      a.movq(dst, a.zax);
+   }
+
+   // Add, Subtract, Multiply, Divide
+   enum ArithFlags
+   {
+      ArithAdd = 1 << 0,
+      ArithSubtract = 1 << 1,
+      ArithMultiply = 1 << 2,
+      ArithDivide = 1 << 3,
+   };
+
+   // The native arithmetic leaves FPSCR untouched, so it is only used in
+   //   the fast FPSCR mode and never for record forms which read cr1.
+   template<unsigned flags>
+   static bool
+      arithGeneric(PPCEmuAssembler& a, Instruction instr)
+   {
+      if (!isFastFpscr() || instr.rc) {
+         return jit_fallback(a, instr);
+      }
+
+      a.movq(a.xmm0, a.ppcfprps[instr.frA][0]);
+
+      if (flags & ArithAdd) {
+         a.addsd(a.xmm0, a.ppcfprps[instr.frB][0]);
+      } else if (flags & ArithSubtract) {
+         a.subsd(a.xmm0, a.ppcfprps[instr.frB][0]);
+      } else if (flags & ArithMultiply) {
+         a.mulsd(a.xmm0, a.ppcfprps[instr.frC][0]);
+      } else if (flags & ArithDivide) {
+         a.divsd(a.xmm0, a.ppcfprps[instr.frB][0]);
+      }
+
+      a.movq(a.ppcfprps[instr.frD][0], a.xmm0);
+      return true;
+   }
+
+   static bool
+      fadd(PPCEmuAssembler& a, Instruction instr)
+   {
+      return arithGeneric<ArithAdd>(a, instr);
+   }
+
+   static bool
+      fadds(PPCEmuAssembler& a, Instruction instr)
+   {
+      return arithGeneric<ArithAdd>(a, instr);
+   }
+
+   static bool
+      fdiv(PPCEmuAssembler& a, Instruction instr)
+   {
+      return arithGeneric<ArithDivide>(a, instr);
    }
 
-   static bool fctiw(PPCEmuAssembler& a, Instruction instr)
+   static bool
+      fdivs(PPCEmuAssembler& a, Instruction instr)
    {
-	   a.movdqu(a.xmm0, a.ppcfpr[instr.frB]);
-	   a.movdqa(a.xmm1, a.ptr(half_qnan_and_s32_max));
-	   a.minsd(a.xmm1, a.xmm0);
-	   a.cvtpd2dq(a.xmm1, a.xmm1);
-	   a.movdqu(a.ppcgpr[instr.frD], a.xmm1);
+      return arithGeneric<ArithDivide>(a, instr);
+   }
 
-	   return true;
+   static bool
+      fmul(PPCEmuAssembler& a, Instruction instr)
+   {
+      return arithGeneric<ArithMultiply>(a, instr);
    }
 
-   static bool fctiwz(PPCEmuAssembler& a, Instruction instr)
+   static bool
+      fmuls(PPCEmuAssembler& a, Instruction instr)
    {
-	   a.movdqu(a.xmm0, a.ppcfpr[instr.frB]);
-	   a.movdqa(a.xmm1, a.ptr(half_qnan_and_s32_max));
-	   a.minsd(a.xmm1, a.xmm0);
-	   a.cvttpd2dq(a.xmm1, a.xmm1);
-	   a.movdqu(a.ppcgpr[instr.frD], a.xmm1);
+      return arithGeneric<ArithMultiply>(a, instr);
+   }
 
-	   return true;
+   static bool
+      fsub(PPCEmuAssembler& a, Instruction instr)
+   {
+      return arithGeneric<ArithSubtract>(a, instr);
    }
 
-   static bool frsp(PPCEmuAssembler& a, Instruction instr)
+   static bool
+      fsubs(PPCEmuAssembler& a, Instruction instr)
    {
-	   a.movdqu(xmm0, a.ppcfpr[instr.frB]);
-	   a.cvtsd2ss(xmm0, xmm0);
-	   a.cvtss2sd(xmm0, xmm0);
-	   a.movddup(xmm0, xmm0);
-	   a.movdqu(a.ppcgpr[instr.frD], a.xmm0);
+      return arithGeneric<ArithSubtract>(a, instr);
+   }
+
+   // Multiply-Add, Multiply-Subtract
+   enum MaddFlags
+   {
+      MaddSubtract = 1 << 0,
+      MaddNegate = 1 << 1,
+   };
+
+   template<unsigned flags = 0>
+   static bool
+      maddGeneric(PPCEmuAssembler& a, Instruction instr)
+   {
+      if (!isFastFpscr() || instr.rc) {
+         return jit_fallback(a, instr);
+      }
+
+      a.movq(a.xmm0, a.ppcfprps[instr.frA][0]);
+      a.mulsd(a.xmm0, a.ppcfprps[instr.frC][0]);
 
-	   return true;
+      if (flags & MaddSubtract) {
+         a.subsd(a.xmm0, a.ppcfprps[instr.frB][0]);
+      } else {
+         a.addsd(a.xmm0, a.ppcfprps[instr.frB][0]);
+      }
+
+      if (flags & MaddNegate) {
+         a.movq(a.zax, a.xmm0);
+         a.btc(a.zax, 63);
+         a.mov(a.ppcfprps[instr.frD][0], a.zax);
+      } else {
+         a.movq(a.ppcfprps[instr.frD][0], a.xmm0);
+      }
+
+      return true;
    }
 
-   static bool fabs(PPCEmuAssembler& a, Instruction instr)
+   static bool
+      fmadd(PPCEmuAssembler& a, Instruction instr)
    {
-	   a.movdqu(a.xmm0, a.ppcfpr[instr.frB]);
-	   a.andps(a.xmm0, a.ptr(psAbsMask));
-	   a.movdqu(a.ppcgpr[instr.frD], a.xmm0);
+      return maddGeneric(a, instr);
+   }
 
-	   return true;
+   static bool
+      fmadds(PPCEmuAssembler& a, Instruction instr)
+   {
+      return maddGeneric(a, instr);
    }
 
-   static bool fnabs(PPCEmuAssembler& a, Instruction instr)
+   static bool
+      fmsub(PPCEmuAssembler& a, Instruction instr)
    {
-	   a.movdqu(a.xmm0, a.ppcfpr[instr.frB]);
-	   a.orps(a.xmm0, a.ptr(psSignBits);
-	   a.movdqu(a.ppcgpr[instr.frD], a.xmm0);
+      return maddGeneric<MaddSubtract>(a, instr);
+   }
 
-	   return true;
+   static bool
+      fmsubs(PPCEmuAssembler& a, Instruction instr)
+   {
+      return maddGeneric<MaddSubtract>(a, instr);
    }
 
-   static bool fmr(PPCEmuAssembler& a, Instruction instr)
+   static bool
+      fnmadd(PPCEmuAssembler& a, Instruction instr)
    {
-	   a.movdqu(a.xmm0, a.ppcfpr[instr.frB]);
-	   a.movsd(a.ppcgpr[instr.frD], a.xmm0);
+      return maddGeneric<MaddNegate>(a, instr);
+   }
 
-	   return true;
+   static bool
+      fnmadds(PPCEmuAssembler& a, Instruction instr)
+   {
+      return maddGeneric<MaddNegate>(a, instr);
    }
 
-   static bool fsign(PPCEmuAssembler& a, Instruction instr)
+   static bool
+      fnmsub(PPCEmuAssembler& a, Instruction instr)
    {
-	   a.movdqu(a.xmm0, a.ppcfpr[instr.frB]);
-	   a.xorps(a.xmm0, a.ptr(psSignBits);
-	   a.movdqu(a.ppcgpr[instr.frD], a.xmm0);
+      return maddGeneric<MaddSubtract | MaddNegate>(a, instr);
+   }
 
-	   return true;
+   static bool
+      fnmsubs(PPCEmuAssembler& a, Instruction instr)
+   {
+      return maddGeneric<MaddSubtract | MaddNegate>(a, instr);
+   }
+
+   // Floating Reciprocal Estimate Single
+   static bool
+      fres(PPCEmuAssembler& a, Instruction instr)
+   {
+      if (!isFastFpscr() || instr.rc) {
+         return jit_fallback(a, instr);
+      }
+
+      loadDouble(a, a.xmm0, 1.0);
+      a.divsd(a.xmm0, a.ppcfprps[instr.frB][0]);
+      a.movq(a.ppcfprps[instr.frD][0], a.xmm0);
+      return true;
+   }
+
+   // Floating Reciprocal Square Root Estimate
+   static bool
+      frsqrte(PPCEmuAssembler& a, Instruction instr)
+   {
+      if (!isFastFpscr() || instr.rc) {
+         return jit_fallback(a, instr);
+      }
+
+      a.sqrtsd(a.xmm1, a.ppcfprps[instr.frB][0]);
+      loadDouble(a, a.xmm0, 1.0);
+      a.divsd(a.xmm0, a.xmm1);
+      a.movq(a.ppcfprps[instr.frD][0], a.xmm0);
+      return true;
+   }
+
+   // Floating Convert to Integer Word with Round toward Zero
+   static bool
+      fctiwz(PPCEmuAssembler& a, Instruction instr)
+   {
+      if (!isFastFpscr() || instr.rc) {
+         return jit_fallback(a, instr);
+      }
+
+      // cvttsd2si gives 0x80000000 for NaN and anything out of range,
+      //   which is right except for values above INT32_MAX.
+      a.movq(a.xmm0, a.ppcfprps[instr.frB][0]);
+      a.cvttsd2si(a.eax, a.xmm0);
+
+      loadDouble(a, a.xmm1, static_cast<double>(INT32_MAX));
+      a.mov(a.ecx, INT32_MAX);
+      a.comisd(a.xmm0, a.xmm1);
+      a.cmova(a.eax, a.ecx);
+
+      // Only iw0, the low word of paired0, is written
+      a.mov(a.ppcfprps[instr.frD][0], a.eax);
+      return true;
+   }
+
+   // Floating Round to Single
+   static bool
+      frsp(PPCEmuAssembler& a, Instruction instr)
+   {
+      if (!isFastFpscr() || instr.rc) {
+         return jit_fallback(a, instr);
+      }
+
+      a.movq(a.xmm0, a.ppcfprps[instr.frB][0]);
+      a.cvtsd2ss(a.xmm0, a.xmm0);
+      a.cvtss2sd(a.xmm0, a.xmm0);
+      a.movq(a.ppcfprps[instr.frD][0], a.xmm0);
+      return true;
+   }
+
+   // Floating Select, d = (a >= 0) ? c : b
+   static bool
+      fsel(PPCEmuAssembler& a, Instruction instr)
+   {
+      a.movq(a.xmm0, a.ppcfprps[instr.frA][0]);
+      a.xorpd(a.xmm1, a.xmm1);
+      a.cmpsd(a.xmm1, a.xmm0, 2); // 0 <= a, false for NaN
+
+      a.movq(a.xmm2, a.ppcfprps[instr.frC][0]);
+      a.movq(a.xmm3, a.ppcfprps[instr.frB][0]);
+      a.andpd(a.xmm2, a.xmm1);
+      a.andnpd(a.xmm1, a.xmm3);
+      a.orpd(a.xmm1, a.xmm2);
+      a.movq(a.ppcfprps[instr.frD][0], a.xmm1);
+
+      if (instr.rc) {
+         updateFloatConditionRegister(a, a.zax, a.zcx);
+      }
+      return true;
+   }
+
+   // Move, Absolute, Negative Absolute, Negate
+   enum SignFlags
+   {
+      SignClear = 1 << 0,
+      SignSet = 1 << 1,
+      SignFlip = 1 << 2,
+   };
+
+   // These never touch FPSCR so they are native in both modes
+   template<unsigned flags = 0>
+   static bool
+      signGeneric(PPCEmuAssembler& a, Instruction instr)
+   {
+      a.mov(a.zax, a.ppcfprps[instr.frB][0]);
+
+      if (flags & SignClear) {
+         a.btr(a.zax, 63);
+      } else if (flags & SignSet) {
+         a.bts(a.zax, 63);
+      } else if (flags & SignFlip) {
+         a.btc(a.zax, 63);
+      }
+
+      a.mov(a.ppcfprps[instr.frD][0], a.zax);
+
+      if (instr.rc) {
+         updateFloatConditionRegister(a, a.zax, a.zcx);
+      }
+      return true;
+   }
+
+   static bool
+      fmr(PPCEmuAssembler& a, Instruction instr)
+   {
+      return signGeneric(a, instr);
+   }
+
+   static bool
+      fabs(PPCEmuAssembler& a, Instruction instr)
+   {
+      return signGeneric<SignClear>(a, instr);
+   }
+
+   static bool
+      fnabs(PPCEmuAssembler& a, Instruction instr)
+   {
+      return signGeneric<SignSet>(a, instr);
+   }
+
+   static bool
+      fneg(PPCEmuAssembler& a, Instruction instr)
+   {
+      return signGeneric<SignFlip>(a, instr);
    }
 
    void registerFloatInstructions()
    {
-      RegisterInstructionFallback(fadd);
-      RegisterInstructionFallback(fadds);
-      RegisterInstructionFallback(fdiv);
-      RegisterInstructionFallback(fdivs);
-      RegisterInstructionFallback(fmul);
-      RegisterInstructionFallback(fmuls);
-      RegisterInstructionFallback(fsub);
-      RegisterInstructionFallback(fsubs);
-      RegisterInstructionFallback(fres);
-      RegisterInstructionFallback(frsqrte);
-      RegisterInstructionFallback(fsel);
-      RegisterInstructionFallback(fmadd);
-      RegisterInstructionFallback(fmadds);
-      RegisterInstructionFallback(fmsub);
-      RegisterInstructionFallback(fmsubs);
-      RegisterInstructionFallback(fnmadd);
-      RegisterInstructionFallback(fnmadds);
-      RegisterInstructionFallback(fnmsub);
-      RegisterInstructionFallback(fnmsubs);
-      RegisterInstruction(fctiw);
+      RegisterInstruction(fadd);
+      RegisterInstruction(fadds);
+      RegisterInstruction(fdiv);
+      RegisterInstruction(fdivs);
+      RegisterInstruction(fmul);
+      RegisterInstruction(fmuls);
+      RegisterInstruction(fsub);
+      RegisterInstruction(fsubs);
+      RegisterInstruction(fres);
+      RegisterInstruction(frsqrte);
+      RegisterInstruction(fsel);
+      RegisterInstruction(fmadd);
+      RegisterInstruction(fmadds);
+      RegisterInstruction(fmsub);
+      RegisterInstruction(fmsubs);
+      RegisterInstruction(fnmadd);
+      RegisterInstruction(fnmadds);
+      RegisterInstruction(fnmsub);
+      RegisterInstruction(fnmsubs);
+      // Rounds by fpscr.rn, which the host conversions don't follow
+      RegisterInstructionFallback(fctiw);
       RegisterInstruction(fctiwz);
       RegisterInstruction(frsp);
       RegisterInstruction(fabs);
@@ -116,5 +372,5 @@ namespace jit
       RegisterInstruction(fneg);
    }
 
-   }
-}
\ No newline at end of file
+}
+}
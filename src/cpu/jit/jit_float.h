@@ -6,8 +6,12 @@ namespace cpu
 namespace jit
 {
 
+   // True when float code may skip FPSCR status and FPRF updates
+   bool
+   isFastFpscr();
+
    void
    updateFloatConditionRegister(PPCEmuAssembler& a, const asmjit::X86GpReg& tmp, const asmjit::X86GpReg& tmp2);
 
 }
-}
\ No newline at end of file
+}
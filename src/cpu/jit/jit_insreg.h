@@ -12,6 +12,7 @@ namespace jit
    using jitinstrfptr_t = bool(*)(PPCEmuAssembler&, Instruction);
 
    bool hasInstruction(InstructionID instrId);
+   jitinstrfptr_t getInstructionHandler(InstructionID id);
    void registerInstruction(InstructionID id, jitinstrfptr_t fptr);
    void registerBranchInstructions();
    void registerConditionInstructions();
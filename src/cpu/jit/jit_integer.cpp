@@ -13,6 +13,18 @@ namespace jit
       auto crtarget = 0;
       auto crshift = (7 - crtarget) * 4;
 
+      if (!a.isCrFieldLive(crtarget)) {
+         return;
+      }
+
+      if (a.crFusableField == crtarget) {
+         a.mov(a.r10d, value);
+         a.mov(a.r11d, 0);
+         a.crPendingField = crtarget;
+         a.crPendingSigned = true;
+         return;
+      }
+
       a.mov(tmp, a.ppccr);
       a.and_(tmp, ~(0xF << crshift));
 
@@ -88,7 +100,7 @@ namespace jit
       if ((flags & AddZeroRA) && instr.rA == 0) {
          a.mov(a.eax, 0);
       } else {
-         a.mov(a.eax, a.ppcgpr[instr.rA]);
+         a.loadGpr(a.eax, instr.rA);
       }
 
       if (flags & AddSubtract) {
@@ -102,7 +114,7 @@ namespace jit
       } else if (flags & AddToMinusOne) {
          a.mov(a.ecx, -1);
       } else {
-         a.mov(a.ecx, a.ppcgpr[instr.rB]);
+         a.loadGpr(a.ecx, instr.rB);
       }
 
       if (flags & AddShifted) {
@@ -158,7 +170,7 @@ namespace jit
          a.mov(a.ppcxer, a.edx);
       }
 
-      a.mov(a.ppcgpr[instr.rD], a.eax);
+      a.storeGpr(instr.rD, a.eax);
 
       if (recordCond) {
          updateConditionRegister(a, a.eax, a.ecx, a.edx);
@@ -235,12 +247,12 @@ namespace jit
    static bool
       andGeneric(PPCEmuAssembler& a, Instruction instr)
    {
-      a.mov(a.eax, a.ppcgpr[instr.rS]);
+      a.loadGpr(a.eax, instr.rS);
 
       if (flags & AndImmediate) {
          a.mov(a.ecx, instr.uimm);
       } else {
-         a.mov(a.ecx, a.ppcgpr[instr.rB]);
+         a.loadGpr(a.ecx, instr.rB);
       }
 
       if (flags & AndShifted) {
@@ -253,7 +265,7 @@ namespace jit
 
       a.and_(a.eax, a.ecx);
 
-      a.mov(a.ppcgpr[instr.rA], a.eax);
+      a.storeGpr(instr.rA, a.eax);
 
       if (flags & AndAlwaysRecord) {
          updateConditionRegister(a, a.eax, a.ecx, a.edx);
@@ -296,7 +308,7 @@ namespace jit
    {
       asmjit::Label lblZero(a);
 
-      a.mov(a.ecx, a.ppcgpr[instr.rS]);
+      a.loadGpr(a.ecx, instr.rS);
       a.mov(a.eax, 32);
 
       a.cmp(a.ecx, 0);
@@ -309,7 +321,7 @@ namespace jit
       a.sub(a.eax, a.edx);
 
       a.bind(lblZero);
-      a.mov(a.ppcgpr[instr.rA], a.eax);
+      a.storeGpr(instr.rA, a.eax);
 
       if (instr.rc) {
          updateConditionRegister(a, a.eax, a.ecx, a.edx);
@@ -343,13 +355,13 @@ namespace jit
    static bool
       eqv(PPCEmuAssembler& a, Instruction instr)
    {
-      a.mov(a.eax, a.ppcgpr[instr.rS]);
-      a.mov(a.ecx, a.ppcgpr[instr.rB]);
+      a.loadGpr(a.eax, instr.rS);
+      a.loadGpr(a.ecx, instr.rB);
 
       a.xor_(a.eax, a.ecx);
       a.not_(a.eax);
 
-      a.mov(a.ppcgpr[instr.rA], a.eax);
+      a.storeGpr(instr.rA, a.eax);
 
       if (instr.rc) {
          updateConditionRegister(a, a.eax, a.ecx, a.edx);
@@ -362,11 +374,11 @@ namespace jit
    static bool
       extsb(PPCEmuAssembler& a, Instruction instr)
    {
-      a.mov(a.eax, a.ppcgpr[instr.rS]);
+      a.loadGpr(a.eax, instr.rS);
 
       a.movsx(a.eax, a.eax.r8());
 
-      a.mov(a.ppcgpr[instr.rA], a.eax);
+      a.storeGpr(instr.rA, a.eax);
 
       if (instr.rc) {
          updateConditionRegister(a, a.eax, a.ecx, a.edx);
@@ -379,11 +391,11 @@ namespace jit
    static bool
       extsh(PPCEmuAssembler& a, Instruction instr)
    {
-      a.mov(a.eax, a.ppcgpr[instr.rS]);
+      a.loadGpr(a.eax, instr.rS);
 
       a.movsx(a.eax, a.eax.r16());
 
-      a.mov(a.ppcgpr[instr.rA], a.eax);
+      a.storeGpr(instr.rA, a.eax);
 
       if (instr.rc) {
          updateConditionRegister(a, a.eax, a.ecx, a.edx);
@@ -406,18 +418,18 @@ namespace jit
    static bool
       mulSignedGeneric(PPCEmuAssembler& a, Instruction instr)
    {
-      a.mov(a.eax, a.ppcgpr[instr.rA]);
+      a.loadGpr(a.eax, instr.rA);
 
       if (flags & MulImmediate) {
          a.mov(a.ecx, sign_extend<16>(instr.simm));
       } else {
-         a.mov(a.ecx, a.ppcgpr[instr.rB]);
+         a.loadGpr(a.ecx, instr.rB);
       }
 
       a.imul(a.ecx);
 
       if (flags & MulLow) {
-         a.mov(a.ppcgpr[instr.rD], a.eax);
+         a.storeGpr(instr.rD, a.eax);
 
          if (flags & MulCheckRecord) {
             if (instr.rc) {
@@ -425,7 +437,7 @@ namespace jit
             }
          }
       } else if (flags & MulHigh) {
-         a.mov(a.ppcgpr[instr.rD], a.edx);
+         a.storeGpr(instr.rD, a.edx);
 
          if (flags & MulCheckRecord) {
             if (instr.rc) {
@@ -444,18 +456,18 @@ namespace jit
    static bool
       mulUnsignedGeneric(PPCEmuAssembler& a, Instruction instr)
    {
-      a.mov(a.eax, a.ppcgpr[instr.rA]);
+      a.loadGpr(a.eax, instr.rA);
 
       if (flags & MulImmediate) {
          a.mov(a.ecx, sign_extend<16>(instr.simm));
       } else {
-         a.mov(a.ecx, a.ppcgpr[instr.rB]);
+         a.loadGpr(a.ecx, instr.rB);
       }
 
       a.mul(a.ecx);
 
       if (flags & MulLow) {
-         a.mov(a.ppcgpr[instr.rD], a.eax);
+         a.storeGpr(instr.rD, a.eax);
 
          if (flags & MulCheckRecord) {
             if (instr.rc) {
@@ -463,7 +475,7 @@ namespace jit
             }
          }
       } else if (flags & MulHigh) {
-         a.mov(a.ppcgpr[instr.rD], a.edx);
+         a.storeGpr(instr.rD, a.edx);
 
          if (flags & MulCheckRecord) {
             if (instr.rc) {
@@ -505,13 +517,13 @@ namespace jit
    static bool
       nand(PPCEmuAssembler& a, Instruction instr)
    {
-      a.mov(a.eax, a.ppcgpr[instr.rS]);
-      a.mov(a.ecx, a.ppcgpr[instr.rB]);
+      a.loadGpr(a.eax, instr.rS);
+      a.loadGpr(a.ecx, instr.rB);
 
       a.and_(a.eax, a.ecx);
       a.not_(a.eax);
 
-      a.mov(a.ppcgpr[instr.rA], a.eax);
+      a.storeGpr(instr.rA, a.eax);
 
       if (instr.rc) {
          updateConditionRegister(a, a.eax, a.ecx, a.edx);
@@ -524,9 +536,9 @@ namespace jit
    static bool
       neg(PPCEmuAssembler& a, Instruction instr)
    {
-      a.mov(a.eax, a.ppcgpr[instr.rA]);
+      a.loadGpr(a.eax, instr.rA);
       a.neg(a.eax);
-      a.mov(a.ppcgpr[instr.rD], a.eax);
+      a.storeGpr(instr.rD, a.eax);
 
       if (instr.oe) {
          a.mov(a.ecx, 0);
@@ -555,13 +567,13 @@ namespace jit
    static bool
       nor(PPCEmuAssembler& a, Instruction instr)
    {
-      a.mov(a.eax, a.ppcgpr[instr.rS]);
-      a.mov(a.ecx, a.ppcgpr[instr.rB]);
+      a.loadGpr(a.eax, instr.rS);
+      a.loadGpr(a.ecx, instr.rB);
 
       a.or_(a.eax, a.ecx);
       a.not_(a.eax);
 
-      a.mov(a.ppcgpr[instr.rA], a.eax);
+      a.storeGpr(instr.rA, a.eax);
 
       if (instr.rc) {
          updateConditionRegister(a, a.eax, a.ecx, a.edx);
@@ -584,12 +596,12 @@ namespace jit
    static bool
       orGeneric(PPCEmuAssembler& a, Instruction instr)
    {
-      a.mov(a.eax, a.ppcgpr[instr.rS]);
+      a.loadGpr(a.eax, instr.rS);
 
       if (flags & OrImmediate) {
          a.mov(a.ecx, instr.uimm);
       } else {
-         a.mov(a.ecx, a.ppcgpr[instr.rB]);
+         a.loadGpr(a.ecx, instr.rB);
       }
 
       if (flags & OrShifted) {
@@ -601,7 +613,7 @@ namespace jit
       }
 
       a.or_(a.eax, a.ecx);
-      a.mov(a.ppcgpr[instr.rA], a.eax);
+      a.storeGpr(instr.rA, a.eax);
 
       if (flags & OrAlwaysRecord) {
          updateConditionRegister(a, a.eax, a.ecx, a.edx);
@@ -650,12 +662,21 @@ namespace jit
    static bool
       rlwGeneric(PPCEmuAssembler& a, Instruction instr)
    {
-      a.mov(a.eax, a.ppcgpr[instr.rS]);
+      if ((flags & RlwImmediate) && a.useBmi2) {
+         // rorx reads the source in place, rotating right by 32 - sh
+         auto n = (32 - instr.sh) & 31;
 
-      if (flags & RlwImmediate) {
+         if (a.gprSlot[instr.rS] >= 0) {
+            a.rorx(a.eax, a.gprCache[a.gprSlot[instr.rS]], n);
+         } else {
+            a.rorx(a.eax, a.ppcgpr[instr.rS], n);
+         }
+      } else if (flags & RlwImmediate) {
+         a.loadGpr(a.eax, instr.rS);
          a.rol(a.eax, instr.sh);
       } else {
-         a.mov(a.ecx, a.ppcgpr[instr.rB]);
+         a.loadGpr(a.eax, instr.rS);
+         a.loadGpr(a.ecx, instr.rB);
          a.and_(a.ecx, 0x1f);
          a.rol(a.eax, a.ecx.r8());
       }
@@ -666,12 +687,12 @@ namespace jit
          a.and_(a.eax, m);
       } else if (flags & RlwInsert) {
          a.and_(a.eax, m);
-         a.mov(a.ecx, a.ppcgpr[instr.rA]);
+         a.loadGpr(a.ecx, instr.rA);
          a.and_(a.ecx, ~m);
          a.or_(a.eax, a.ecx);
       }
 
-      a.mov(a.ppcgpr[instr.rA], a.eax);
+      a.storeGpr(instr.rA, a.eax);
 
       if (instr.rc) {
          updateConditionRegister(a, a.eax, a.ecx, a.edx);
@@ -713,7 +734,7 @@ namespace jit
    static bool
       shiftLogical(PPCEmuAssembler& a, Instruction instr)
    {
-      a.mov(a.eax, a.ppcgpr[instr.rS]);
+      a.loadGpr(a.eax, instr.rS);
 
       if (flags & ShiftImmediate) {
          if (flags & ShiftLeft) {
@@ -724,7 +745,7 @@ namespace jit
             assert(0);
          }
       } else {
-         a.mov(a.ecx, a.ppcgpr[instr.rB]);
+         a.loadGpr(a.ecx, instr.rB);
 
          if (flags & ShiftLeft) {
             a.shl(a.eax, a.ecx.r8());
@@ -735,7 +756,7 @@ namespace jit
          }
       }
 
-      a.mov(a.ppcgpr[instr.rA], a.eax);
+      a.storeGpr(instr.rA, a.eax);
 
       if (instr.rc) {
          updateConditionRegister(a, a.eax, a.ecx, a.edx);
@@ -835,12 +856,12 @@ namespace jit
    static bool
       xorGeneric(PPCEmuAssembler& a, Instruction instr)
    {
-      a.mov(a.eax, a.ppcgpr[instr.rS]);
+      a.loadGpr(a.eax, instr.rS);
 
       if (flags & XorImmediate) {
          a.mov(a.ecx, instr.uimm);
       } else {
-         a.mov(a.ecx, a.ppcgpr[instr.rB]);
+         a.loadGpr(a.ecx, instr.rB);
       }
 
       if (flags & XorShifted) {
@@ -848,7 +869,7 @@ namespace jit
       }
 
       a.xor_(a.eax, a.ecx);
-      a.mov(a.ppcgpr[instr.rA], a.eax);
+      a.storeGpr(instr.rA, a.eax);
 
       if (flags & XorCheckRecord) {
          if (instr.rc) {
@@ -1,5 +1,8 @@
 #pragma once
+#include <cassert>
 #include <map>
+#include <string>
+#include <vector>
 #include <asmjit/asmjit.h>
 #include "../cpu.h"
 
@@ -9,21 +12,109 @@ namespace jit
 {
 
    static const bool JIT_CONTINUE_ON_ERROR = false;
+
+   // Emits NOP padding and `mov edi, cia` around every guest instruction,
+   //   which makes the generated code easier to follow in a debugger.
+   static const bool JIT_DEBUG_MARKERS = false;
    static const int JIT_MAX_INST = 20000;
 
+   // Interpreted entries before a block is compiled in tiered mode
+   static const uint32_t JIT_TIER1_THRESHOLD = 64;
+
+   // Largest leaf function which is inlined into its callers
+   static const uint32_t JIT_INLINE_MAX_INST = 32;
+
+   // Total inlined instructions allowed per block
+   static const uint32_t JIT_INLINE_BUDGET = 256;
+
+   // Baseline entries before a block is recompiled optimised
+   static const int32_t JIT_TIER2_THRESHOLD = 4096;
+
    /*
    Register Assignments:
    RAX . Scratch
    RCX . Scratch
    RDX . Scratch
-   RDI . Scratch
+   RDI . Current CIA, only with JIT_DEBUG_MARKERS
    RSI . mem::base()
    RBX . ThreadState*
-   RBP .
+   RBP . Cached PPCGPR
    RSP . Emu Stack Pointer.
-   R8-R15 . PPCGPR Storage
+   R8-R9 . Scratch
+   R10-R11 . Deferred compare operands
+   R12-R15 . Cached PPCGPR
    */
 
+   static const int JIT_GPR_CACHE_SIZE = 5;
+
+   // Host addresses used by generated code are loaded from a literal
+   //   pool at the end of the block, so the code can be saved to the
+   //   JIT cache and relocated by rewriting the pool.
+   enum class JitRelocKind : uint32_t {
+      Finale,
+      InterpreterHandler,
+      KernelCallFn,
+      KernelCallData
+   };
+
+   struct JitReloc {
+      JitRelocKind kind;
+      uint32_t index;
+      uint32_t offset;
+   };
+
+   enum class JitAccessKind : uint8_t {
+      Load,
+      Store
+   };
+
+   // A single host instruction accessing guest memory through membase,
+   //   loads always target rax.
+   struct JitAccessSite {
+      uint32_t offset;
+      uint8_t length;
+      JitAccessKind kind;
+   };
+
+   // Optional host instructions the generator may use
+   struct JitHostFeatures {
+      bool movbe;
+      bool bmi2;
+
+      uint32_t bits() const {
+         return (movbe ? 1 : 0) | (bmi2 ? 2 : 0);
+      }
+   };
+
+   const JitHostFeatures& getHostFeatures();
+
+   // Updated by generated code without locking, so the counts are
+   //   approximate when several cores run the same block.
+   struct JitProfile {
+      uint32_t start;
+      uint64_t entries;
+      uint64_t cycles;
+      uint64_t fallbacks;
+   };
+
+   struct JitGqrHint {
+      bool valid;
+      uint32_t value[8];
+   };
+
+   static inline JitGqrHint
+   getGqrHint(const ThreadState *state)
+   {
+      JitGqrHint hint;
+      hint.valid = !!state;
+
+      for (auto i = 0; i < 8; ++i) {
+         hint.value[i] = state ? state->gqr[i].value : 0;
+      }
+
+      return hint;
+   }
+
    class PPCEmuAssembler : public asmjit::X86Assembler {
    private:
       class ErrorHandler : public asmjit::ErrorHandler {
@@ -42,6 +133,8 @@ namespace jit
          edx = zdx.r32();
          r8d = asmjit::x86::r8d;
          r9d = asmjit::x86::r9d;
+         r10d = asmjit::x86::r10d;
+         r11d = asmjit::x86::r11d;
 
 #define PPCTSReg(mm) asmjit::X86Mem(zbx, (int32_t)offsetof(ThreadState, mm), sizeof(ThreadState::mm))
          for (auto i = 0; i < 32; ++i) {
@@ -52,6 +145,8 @@ namespace jit
             ppcfprps[i][0] = PPCTSReg(fpr[i].paired0);
             ppcfprps[i][1] = PPCTSReg(fpr[i].paired1);
          }
+         ppccia = PPCTSReg(cia);
+         ppcnia = PPCTSReg(nia);
          ppccr = PPCTSReg(cr);
          ppcxer = PPCTSReg(xer.value);
          ppclr = PPCTSReg(lr);
@@ -63,6 +158,10 @@ namespace jit
          ppcreserve = PPCTSReg(reserve);
          ppcreserveAddress = PPCTSReg(reserveAddress);
          ppcreserveData = PPCTSReg(reserveData);
+         ppcrsb = PPCTSReg(rsb);
+         ppcrsbTop = PPCTSReg(rsbTop);
+         ppcprofileBlock = PPCTSReg(profileBlock);
+         ppcprofileStart = PPCTSReg(profileStart);
 #undef PPCTSReg
 
          state = zbx;
@@ -71,6 +170,30 @@ namespace jit
 
          xmm0 = asmjit::x86::xmm0;
          xmm1 = asmjit::x86::xmm1;
+         xmm2 = asmjit::x86::xmm2;
+         xmm3 = asmjit::x86::xmm3;
+
+         gprCache[0] = asmjit::x86::ebp;
+         gprCache[1] = asmjit::x86::r12d;
+         gprCache[2] = asmjit::x86::r13d;
+         gprCache[3] = asmjit::x86::r14d;
+         gprCache[4] = asmjit::x86::r15d;
+         for (auto i = 0; i < 32; ++i) {
+            gprSlot[i] = -1;
+         }
+         gprCacheWrites = 0;
+         gprKnown = 0;
+
+         crLiveOut = 0xFF;
+         crFusableField = -1;
+         crPendingField = -1;
+         crPendingSigned = false;
+
+         gqrHint.valid = false;
+         genCia = 0;
+
+         useMovbe = getHostFeatures().movbe;
+         useBmi2 = getHostFeatures().bmi2;
       }
 
       void shiftTo(asmjit::X86GpReg reg, int s, int d) {
@@ -81,6 +204,105 @@ namespace jit
          }
       }
 
+      // Guest GPRs must only be accessed through these so that
+      //   registers cached in host registers stay coherent.
+      void loadGpr(const asmjit::X86GpReg& dst, uint32_t gpr) {
+         if (gprSlot[gpr] >= 0) {
+            mov(dst, gprCache[gprSlot[gpr]]);
+         } else {
+            mov(dst, ppcgpr[gpr]);
+         }
+      }
+
+      void storeGpr(uint32_t gpr, const asmjit::X86GpReg& src) {
+         if (gprSlot[gpr] >= 0) {
+            assert(gprCacheWrites & (1u << gpr));
+            mov(gprCache[gprSlot[gpr]], src);
+         } else {
+            mov(ppcgpr[gpr], src);
+         }
+      }
+
+      void storeGprImm(uint32_t gpr, uint32_t value) {
+         if (gprSlot[gpr] >= 0) {
+            assert(gprCacheWrites & (1u << gpr));
+            mov(gprCache[gprSlot[gpr]], value);
+         } else {
+            mov(ppcgpr[gpr], value);
+         }
+      }
+
+      // Loads gpr + offset, a single mov when gpr holds a known constant
+      void loadGprOffset(const asmjit::X86GpReg& dst, uint32_t gpr, int32_t offset) {
+         if (gprKnown & (1u << gpr)) {
+            mov(dst, static_cast<uint32_t>(gprValue[gpr] + offset));
+         } else {
+            loadGpr(dst, gpr);
+
+            if (offset != 0) {
+               add(dst, offset);
+            }
+         }
+      }
+
+      // Write back cached registers before leaving generated code
+      //   or calling something which reads the ThreadState.
+      void flushGprs() {
+         for (auto i = 0; i < 32; ++i) {
+            if (gprSlot[i] >= 0 && (gprCacheWrites & (1u << i))) {
+               mov(ppcgpr[i], gprCache[gprSlot[i]]);
+            }
+         }
+      }
+
+      // Reload cached registers on block entry or after a call
+      //   which may have modified the ThreadState.
+      void reloadGprs() {
+         for (auto i = 0; i < 32; ++i) {
+            if (gprSlot[i] >= 0) {
+               mov(gprCache[gprSlot[i]], ppcgpr[i]);
+            }
+         }
+      }
+
+      // Returns a rip relative operand for a literal holding value
+      asmjit::X86Mem hostLiteral(JitRelocKind kind, uint32_t index, const void *value) {
+         for (auto &literal : literals) {
+            if (literal.kind == kind && literal.index == index) {
+               return asmjit::x86::qword_ptr(literal.label);
+            }
+         }
+
+         asmjit::Label label(*this);
+         literals.push_back({ kind, index, reinterpret_cast<uint64_t>(value), label });
+         return asmjit::x86::qword_ptr(label);
+      }
+
+      void emitLiterals() {
+         align(asmjit::kAlignData, 8);
+
+         for (auto &literal : literals) {
+            bind(literal.label);
+            embed(&literal.value, sizeof(literal.value));
+         }
+      }
+
+      // Stores the current instruction address for code which may observe
+      //   it, generated code otherwise never keeps ThreadState::cia updated.
+      void materializeCia() {
+         mov(ppccia, genCia);
+         mov(ppcnia, genCia + 4);
+      }
+
+      bool hasCachedGprs() const {
+         for (auto i = 0; i < 32; ++i) {
+            if (gprSlot[i] >= 0) {
+               return true;
+            }
+         }
+         return false;
+      }
+
       asmjit::X86GpReg state;
       asmjit::X86GpReg membase;
       asmjit::X86GpReg cia;
@@ -90,13 +312,19 @@ namespace jit
       asmjit::X86GpReg edx;
       asmjit::X86GpReg r8d;
       asmjit::X86GpReg r9d;
+      asmjit::X86GpReg r10d;
+      asmjit::X86GpReg r11d;
 
       asmjit::X86XmmReg xmm0;
       asmjit::X86XmmReg xmm1;
+      asmjit::X86XmmReg xmm2;
+      asmjit::X86XmmReg xmm3;
 
       asmjit::X86Mem ppcgpr[32];
       asmjit::X86Mem ppcfpr[32];
       asmjit::X86Mem ppcfprps[32][2];
+      asmjit::X86Mem ppccia;
+      asmjit::X86Mem ppcnia;
       asmjit::X86Mem ppccr;
       asmjit::X86Mem ppcxer;
       asmjit::X86Mem ppclr;
@@ -107,6 +335,78 @@ namespace jit
       asmjit::X86Mem ppcreserve;
       asmjit::X86Mem ppcreserveAddress;
       asmjit::X86Mem ppcreserveData;
+      asmjit::X86Mem ppcrsb;
+      asmjit::X86Mem ppcrsbTop;
+      asmjit::X86Mem ppcprofileBlock;
+      asmjit::X86Mem ppcprofileStart;
+
+      asmjit::X86GpReg gprCache[JIT_GPR_CACHE_SIZE];
+      int gprSlot[32];
+      uint32_t gprCacheWrites;
+
+      // GPRs known to hold gprValue before the current instruction
+      uint32_t gprKnown;
+      uint32_t gprValue[32];
+
+      // Guest address of the instruction being generated.
+      uint32_t genCia;
+
+      // CR fields which may be read after the current instruction.
+      uint8_t crLiveOut;
+
+      // CR field tested by the next instruction if it is a branch
+      //   which can consume a deferred compare, otherwise -1.
+      int crFusableField;
+
+      // CR field whose compare is deferred in r10d/r11d, otherwise -1.
+      int crPendingField;
+      bool crPendingSigned;
+
+      bool isCrFieldLive(uint32_t field) const {
+         return !!(crLiveOut & (1 << field));
+      }
+
+      // GQR values seen when the block was requested, psq_l and psq_st
+      //   are specialised on them behind a guard.
+      JitGqrHint gqrHint;
+
+      // movbe for guest memory, rorx for rotates
+      bool useMovbe;
+      bool useBmi2;
+
+      // Counters of the block being generated when profiling
+      JitProfile *profile = nullptr;
+
+      struct Literal {
+         JitRelocKind kind;
+         uint32_t index;
+         uint64_t value;
+         asmjit::Label label;
+      };
+
+      std::vector<Literal> literals;
+
+      // Direct exits emitted by genBlockExit, resolved to host
+      //   addresses once the block has been made.
+      std::vector<std::pair<uint32_t, asmjit::Label>> exitLabels;
+
+      // Return addresses of calls pushed to the return stack, each gets
+      //   an exit site at the end of the block which blr jumps to.
+      std::vector<std::pair<uint32_t, asmjit::Label>> returnPads;
+
+      // Wrap the one instruction of a guest memory access, so that the
+      //   fault handler can step over it when the page is unmapped.
+      void beginGuestAccess() {
+         accessStart = static_cast<uint32_t>(getOffset());
+      }
+
+      void endGuestAccess(JitAccessKind kind) {
+         auto length = static_cast<uint32_t>(getOffset()) - accessStart;
+         accessSites.push_back({ accessStart, static_cast<uint8_t>(length), kind });
+      }
+
+      uint32_t accessStart = 0;
+      std::vector<JitAccessSite> accessSites;
    };
 
    template<typename T, typename Z>
@@ -123,19 +423,140 @@ namespace jit
    extern JitCall gCallFn;
    extern JitFinale gFinaleFn;
 
+   struct JitExit {
+      uint32_t target;
+      uint8_t *site;
+   };
+
+   enum class JitTier {
+      // Quick to compile, counts its entries to find the hottest blocks
+      Baseline,
+
+      // Register caching and CR liveness analysis
+      Optimised
+   };
+
+   // A call at site to a leaf function whose body is [start, end) and
+   //   which returns with the unconditional blr at end.
+   struct JitInline {
+      uint32_t site;
+      uint32_t start;
+      uint32_t end;
+   };
+
    struct JitBlock {
-      JitBlock(uint32_t _start) {
+      JitBlock(uint32_t _start, JitTier _tier = JitTier::Optimised) {
          start = _start;
          end = _start;
          entry = nullptr;
+         tier = _tier;
+         code = nullptr;
+         codeSize = 0;
+         gqrHint.valid = false;
       }
 
       uint32_t start;
       uint32_t end;
+      JitTier tier;
 
       JitCode entry;
       std::map<uint32_t, JitCode> targets;
+      std::vector<JitExit> exits;
+
+      // Generated code and its literals, for the JIT cache
+      uint8_t *code;
+      uint32_t codeSize;
+      std::vector<JitReloc> relocs;
+
+      JitGqrHint gqrHint;
+
+      // Pairs of (host code offset, guest address) sorted by offset, maps
+      //   a host PC inside the block back to its guest instruction.
+      std::vector<std::pair<uint32_t, uint32_t>> addressMap;
+
+      // Calls compiled inline, ordered by site
+      std::vector<JitInline> inlines;
+
+      // Guest memory accesses sorted by offset
+      std::vector<JitAccessSite> accessSites;
+
+      // True if the block was compiled from any guest code in the range
+      bool overlaps(uint32_t address, uint32_t rangeEnd) const {
+         if (start < rangeEnd && end > address) {
+            return true;
+         }
+
+         for (auto &callee : inlines) {
+            if (callee.start < rangeEnd && callee.end + 4 > address) {
+               return true;
+            }
+         }
+
+         return false;
+      }
    };
 
+   // Computes for each instruction of the block which CR fields
+   //   may be read after it, indexed by (cia - block.start) / 4.
+   void analyseCrLiveness(const JitBlock& block, std::vector<uint8_t>& liveOut);
+
+   struct JitGprInfo {
+      // GPRs holding a known constant before the instruction
+      uint32_t known = 0;
+      uint32_t value[32] = { 0 };
+
+      // Only writes GPRs which are overwritten before being read
+      bool dead = false;
+
+      // Only writes the known constant result to GPR dest
+      bool constant = false;
+      uint32_t dest = 0;
+      uint32_t result = 0;
+   };
+
+   // Propagates constants through simple integer instructions and finds
+   //   their dead writes, indexed by (cia - block.start) / 4.
+   void analyseGprs(const JitBlock& block, std::vector<JitGprInfo>& info);
+
+   // Writes the compare of r10d with r11d into CR field crfD.
+   void genCrFieldUpdate(PPCEmuAssembler& a, uint32_t crfD, bool isSigned);
+
+   // Returns the counters for blocks starting at start, shared by every
+   //   compile of it, or nullptr when profiling is disabled.
+   JitProfile *getProfile(uint32_t start);
+
+   // Counts an entry into the block, clobbers rax, rcx, rdx and r8
+   void genProfileEntry(PPCEmuAssembler& a);
+
+   // Adds the block's host code to the perf map if one is open
+   void writePerfMap(const JitBlock& block);
+
+   // Loads a block saved by a previous run if its guest code is unchanged
+   bool restoreCachedBlock(asmjit::Runtime *runtime, JitBlock& block);
+
+   // Must be called with the block list locked
+   bool writeCache(const std::string &path, const std::map<uint32_t, JitBlock>& blocks);
+
+   // Returns the guest instruction containing host address pc, or 0 if
+   //   pc is not inside a compiled block.
+   uint32_t findGuestAddress(const void *pc);
+   bool findAccessSite(const void *pc, JitAccessSite& site, uint32_t& guestAddress);
+
+   uint32_t execute(ThreadState *state, JitCode block);
+
+   // Guest ranges the block entered at addr runs before leaving through an
+   //   exit, its own code then any inlined callees. Empty if addr has no
+   //   entry.
+   std::vector<std::pair<uint32_t, uint32_t>> getBlockRanges(uint32_t addr);
+
+   // Interprets the ranges on a copy of state, then runs block on state
+   //   and compares the two. Returns the nia the block exited to.
+   uint32_t verifyBlock(ThreadState *state, JitCode block, const std::vector<std::pair<uint32_t, uint32_t>>& ranges);
+
+   // Emits a patchable exit to nia, which is later linked
+   //   directly to the block at nia once it is compiled.
+   void genBlockExit(PPCEmuAssembler& a, uint32_t nia);
+   void genExitSite(PPCEmuAssembler& a, uint32_t nia, asmjit::Label& exitLabel);
+
 }
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include "jit_insreg.h"
 #include "bitutils.h"
 
@@ -18,50 +20,126 @@ namespace jit
       LoadZeroRA = 1 << 5, // Use 0 instead of r0
    };
 
-   template<typename Type, unsigned flags = 0>
-   static bool
-      loadGeneric(PPCEmuAssembler& a, Instruction instr)
+   // Reads size bytes at [base + offset] into eax, or rax for 8 bytes,
+   //   as a single guest access. Swaps them into host order unless told
+   //   not to, using movbe when the host has it.
+   static void
+   genGuestRead(PPCEmuAssembler& a, const asmjit::X86GpReg& base, int32_t offset, size_t size, bool swap = true)
    {
-      if ((flags & LoadZeroRA) && instr.rA == 0) {
-         a.mov(a.ecx, 0u);
+      auto movbe = swap && a.useMovbe;
+
+      a.beginGuestAccess();
+
+      if (size == 1) {
+         a.movzx(a.eax, asmjit::x86::byte_ptr(base, offset));
+      } else if (size == 2) {
+         if (movbe) {
+            a.movbe(a.eax.r16(), asmjit::x86::word_ptr(base, offset));
+         } else {
+            a.movzx(a.eax, asmjit::x86::word_ptr(base, offset));
+         }
+      } else if (size == 4) {
+         if (movbe) {
+            a.movbe(a.eax, asmjit::x86::dword_ptr(base, offset));
+         } else {
+            a.mov(a.eax, asmjit::x86::dword_ptr(base, offset));
+         }
+      } else if (size == 8) {
+         if (movbe) {
+            a.movbe(a.zax, asmjit::x86::qword_ptr(base, offset));
+         } else {
+            a.mov(a.zax, asmjit::x86::qword_ptr(base, offset));
+         }
       } else {
-         a.mov(a.ecx, a.ppcgpr[instr.rA]);
+         assert(0);
       }
 
-      if (flags & LoadIndexed) {
-         a.add(a.ecx, a.ppcgpr[instr.rB]);
-      } else {
-         auto x = sign_extend<16, int32_t>(instr.d);
-         if (x != 0) {
-            a.add(a.ecx, x);
+      a.endGuestAccess(JitAccessKind::Load);
+
+      if (size == 2) {
+         if (movbe) {
+            a.movzx(a.eax, a.eax.r16());
+         } else if (swap) {
+            a.xchg(a.eax.r8Hi(), a.eax.r8Lo());
          }
+      } else if (size == 4 && swap && !movbe) {
+         a.bswap(a.eax);
+      } else if (size == 8 && swap && !movbe) {
+         a.bswap(a.zax);
       }
+   }
 
-      a.mov(a.zdx, a.zcx);
-      a.add(a.zdx, a.membase);
-      if (sizeof(Type) == 1) {
-         a.mov(a.eax, 0);
-         a.mov(a.eax.r8(), asmjit::X86Mem(a.zdx, 0));
-      } else if (sizeof(Type) == 2) {
-         a.mov(a.eax, 0);
-         a.mov(a.eax.r16(), asmjit::X86Mem(a.zdx, 0));
-         if (!(flags & LoadByteReverse)) {
+   // Writes size bytes of eax, or rax for 8 bytes, to [base + offset] as
+   //   a single guest access, swapping them unless told not to. eax is
+   //   clobbered when swapping.
+   static void
+   genGuestWrite(PPCEmuAssembler& a, const asmjit::X86GpReg& base, int32_t offset, size_t size, bool swap = true)
+   {
+      auto movbe = swap && a.useMovbe;
+
+      if (swap && !movbe) {
+         if (size == 2) {
             a.xchg(a.eax.r8Hi(), a.eax.r8Lo());
-         }
-      } else if (sizeof(Type) == 4) {
-         a.mov(a.eax, asmjit::X86Mem(a.zdx, 0));
-         if (!(flags & LoadByteReverse)) {
+         } else if (size == 4) {
             a.bswap(a.eax);
-         }
-      } else if (sizeof(Type) == 8) {
-         a.mov(a.zax, asmjit::X86Mem(a.zdx, 0));
-         if (!(flags & LoadByteReverse)) {
+         } else if (size == 8) {
             a.bswap(a.zax);
          }
+      }
+
+      a.beginGuestAccess();
+
+      if (size == 1) {
+         a.mov(asmjit::x86::byte_ptr(base, offset), a.eax.r8());
+      } else if (size == 2) {
+         if (movbe) {
+            a.movbe(asmjit::x86::word_ptr(base, offset), a.eax.r16());
+         } else {
+            a.mov(asmjit::x86::word_ptr(base, offset), a.eax.r16());
+         }
+      } else if (size == 4) {
+         if (movbe) {
+            a.movbe(asmjit::x86::dword_ptr(base, offset), a.eax);
+         } else {
+            a.mov(asmjit::x86::dword_ptr(base, offset), a.eax);
+         }
+      } else if (size == 8) {
+         if (movbe) {
+            a.movbe(asmjit::x86::qword_ptr(base, offset), a.zax);
+         } else {
+            a.mov(asmjit::x86::qword_ptr(base, offset), a.zax);
+         }
       } else {
          assert(0);
       }
 
+      a.endGuestAccess(JitAccessKind::Store);
+   }
+
+   template<typename Type, unsigned flags = 0>
+   static bool
+      loadGeneric(PPCEmuAssembler& a, Instruction instr)
+   {
+      if (flags & LoadIndexed) {
+         if ((flags & LoadZeroRA) && instr.rA == 0) {
+            a.mov(a.ecx, 0u);
+         } else {
+            a.loadGpr(a.ecx, instr.rA);
+         }
+
+         a.loadGpr(a.edx, instr.rB);
+         a.add(a.ecx, a.edx);
+      } else if ((flags & LoadZeroRA) && instr.rA == 0) {
+         a.mov(a.ecx, sign_extend<16, int32_t>(instr.d));
+      } else {
+         // A single mov when rA is a known constant, such as after lis
+         a.loadGprOffset(a.ecx, instr.rA, sign_extend<16, int32_t>(instr.d));
+      }
+
+      a.mov(a.zdx, a.zcx);
+      a.add(a.zdx, a.membase);
+      genGuestRead(a, a.zdx, 0, sizeof(Type), !(flags & LoadByteReverse));
+
       if (std::is_floating_point<Type>::value) {
          if (sizeof(Type) == 4) {
             a.movq(a.xmm0, a.zax);
@@ -77,7 +155,7 @@ namespace jit
             a.movsx(a.eax, a.eax.r16());
          }
 
-         a.mov(a.ppcgpr[instr.rD], a.eax);
+         a.storeGpr(instr.rD, a.eax);
       }
 
       if (flags & LoadReserve) {
@@ -85,13 +163,12 @@ namespace jit
          a.mov(a.ppcreserveAddress, a.ecx);
          a.mov(a.zdx, a.ecx);
          a.add(a.zdx, a.membase);
-         a.mov(a.eax, asmjit::X86Mem(a.zdx, 0));
-         a.bswap(a.eax);
+         genGuestRead(a, a.zdx, 0, 4);
          a.mov(a.ppcreserveData, a.eax);
       }
 
       if (flags & LoadUpdate) {
-         a.mov(a.ppcgpr[instr.rA], a.ecx);
+         a.storeGpr(instr.rA, a.ecx);
       }
       return true;
    }
@@ -265,7 +342,7 @@ namespace jit
    {
       auto o = sign_extend<16, int32_t>(instr.d);
       if (instr.rA) {
-         a.mov(a.ecx, a.ppcgpr[instr.rA]);
+         a.loadGpr(a.ecx, instr.rA);
          if (o != 0) {
             a.add(a.ecx, o);
          }
@@ -275,9 +352,8 @@ namespace jit
       a.add(a.zcx, a.membase);
 
       for (int r = instr.rD, d = 0; r <= 31; ++r, d += 4) {
-         a.mov(a.eax, asmjit::X86Mem(a.zcx, d));
-         a.bswap(a.eax);
-         a.mov(a.ppcgpr[r], a.eax);
+         genGuestRead(a, a.zcx, d, 4);
+         a.storeGpr(r, a.eax);
       }
       return true;
    }
@@ -329,21 +405,16 @@ namespace jit
 
       if ((flags & StoreZeroRA) && instr.rA == 0) {
          if (flags & StoreIndexed) {
-            a.mov(a.ecx, a.ppcgpr[instr.rB]);
+            a.loadGpr(a.ecx, instr.rB);
          } else {
             a.mov(a.ecx, sign_extend<16, int32_t>(instr.d));
          }
+      } else if (flags & StoreIndexed) {
+         a.loadGpr(a.ecx, instr.rA);
+         a.loadGpr(a.edx, instr.rB);
+         a.add(a.ecx, a.edx);
       } else {
-         a.mov(a.ecx, a.ppcgpr[instr.rA]);
-
-         if (flags & StoreIndexed) {
-            a.add(a.ecx, a.ppcgpr[instr.rB]);
-         } else {
-            auto x = sign_extend<16, int32_t>(instr.d);
-            if (x != 0) {
-               a.add(a.ecx, x);
-            }
-         }
+         a.loadGprOffset(a.ecx, instr.rA, sign_extend<16, int32_t>(instr.d));
       }
 
       if (flags & StoreConditional) {
@@ -378,45 +449,20 @@ namespace jit
          }
       } else {
          if (sizeof(Type) == 1) {
-            a.mov(a.eax.r8(), a.ppcgpr[instr.rS]);
-         } else if (sizeof(Type) == 2) {
-            a.mov(a.eax.r16(), a.ppcgpr[instr.rS]);
-         } else if (sizeof(Type) == 4) {
-            a.mov(a.eax, a.ppcgpr[instr.rS]);
-         } else {
-            assert(0);
-         }
-      }
-
-      if (!(flags & StoreByteReverse)) {
-         if (sizeof(Type) == 1) {
-            // Inverted reverse logic means we have
-            //    to check for this but do nothing.
+            a.loadGpr(a.eax, instr.rS);
          } else if (sizeof(Type) == 2) {
-            a.xchg(a.eax.r8Hi(), a.eax.r8Lo());
+            a.loadGpr(a.eax, instr.rS);
          } else if (sizeof(Type) == 4) {
-            a.bswap(a.eax);
-         } else if (sizeof(Type) == 8) {
-            a.bswap(a.zax);
+            a.loadGpr(a.eax, instr.rS);
          } else {
             assert(0);
          }
       }
 
-      if (sizeof(Type) == 1) {
-         a.mov(asmjit::X86Mem(a.zdx, 0), a.eax.r8());
-      } else if (sizeof(Type) == 2) {
-         a.mov(asmjit::X86Mem(a.zdx, 0), a.eax.r16());
-      } else if (sizeof(Type) == 4) {
-         a.mov(asmjit::X86Mem(a.zdx, 0), a.eax);
-      } else if (sizeof(Type) == 8) {
-         a.mov(asmjit::X86Mem(a.zdx, 0), a.zax);
-      } else {
-         assert(0);
-      }
+      genGuestWrite(a, a.zdx, 0, sizeof(Type), !(flags & StoreByteReverse));
 
       if (flags & StoreUpdate) {
-         a.mov(a.ppcgpr[instr.rA], a.ecx);
+         a.storeGpr(instr.rA, a.ecx);
       }
 
       return true;
@@ -573,7 +619,7 @@ namespace jit
    {
       auto o = sign_extend<16, int32_t>(instr.d);
       if (instr.rA) {
-         a.mov(a.ecx, a.ppcgpr[instr.rA]);
+         a.loadGpr(a.ecx, instr.rA);
          if (o != 0) {
             a.add(a.ecx, o);
          }
@@ -583,9 +629,8 @@ namespace jit
       a.add(a.zcx, a.membase);
 
       for (int r = instr.rS, d = 0; r <= 31; ++r, d += 4) {
-         a.mov(a.eax, a.ppcgpr[r]);
-         a.bswap(a.eax);
-         a.mov(asmjit::X86Mem(a.zcx, d), a.eax);
+         a.loadGpr(a.eax, r);
+         genGuestWrite(a, a.zcx, d, 4);
       }
       return true;
    }
@@ -623,11 +668,147 @@ namespace jit
       PsqLoadIndexed = 1 << 2,
    };
 
+   // Loads a double constant into dst
+   static void
+   loadDouble(PPCEmuAssembler& a, const asmjit::X86XmmReg& dst, double value)
+   {
+      a.mov(a.zax, bit_cast<uint64_t>(value));
+      a.movq(dst, a.zax);
+   }
+
+   static uint32_t
+   getQuantizedSize(QuantizedDataType type)
+   {
+      switch (type) {
+      case QuantizedDataType::Floating:
+         return 4;
+      case QuantizedDataType::Unsigned8:
+      case QuantizedDataType::Signed8:
+         return 1;
+      case QuantizedDataType::Unsigned16:
+      case QuantizedDataType::Signed16:
+         return 2;
+      default:
+         return 0;
+      }
+   }
+
+   // Calculates the psq_l / psq_st effective address into ecx, both
+   //   share the same ZeroRA and Indexed flag values.
+   template<unsigned flags>
+   static void
+   genPsqAddress(PPCEmuAssembler& a, Instruction instr)
+   {
+      if ((flags & PsqLoadZeroRA) && instr.rA == 0) {
+         a.mov(a.ecx, 0u);
+      } else {
+         a.loadGpr(a.ecx, instr.rA);
+      }
+
+      if (flags & PsqLoadIndexed) {
+         a.loadGpr(a.edx, instr.rB);
+         a.add(a.ecx, a.edx);
+      } else {
+         auto x = sign_extend<12, int32_t>(instr.qd);
+         if (x != 0) {
+            a.add(a.ecx, x);
+         }
+      }
+
+      a.mov(a.zdx, a.zcx);
+      a.add(a.zdx, a.membase);
+   }
+
+   // Reads the element at [rdx + offset] into dst, as dequantize does
+   static void
+   genDequantize(PPCEmuAssembler& a, const asmjit::X86XmmReg& dst, QuantizedDataType type, uint32_t scale, uint32_t offset)
+   {
+      switch (type) {
+      case QuantizedDataType::Floating:
+         genGuestRead(a, a.zdx, offset, 4);
+         a.movd(dst, a.eax);
+         a.cvtss2sd(dst, dst);
+         return;
+      case QuantizedDataType::Unsigned8:
+         genGuestRead(a, a.zdx, offset, 1);
+         break;
+      case QuantizedDataType::Signed8:
+         a.beginGuestAccess();
+         a.movsx(a.eax, asmjit::x86::byte_ptr(a.zdx, offset));
+         a.endGuestAccess(JitAccessKind::Load);
+         break;
+      case QuantizedDataType::Unsigned16:
+         genGuestRead(a, a.zdx, offset, 2);
+         break;
+      case QuantizedDataType::Signed16:
+         genGuestRead(a, a.zdx, offset, 2);
+         a.movsx(a.eax, a.eax.r16());
+         break;
+      default:
+         assert(0);
+      }
+
+      a.cvtsi2sd(dst, a.eax);
+
+      if (scale) {
+         loadDouble(a, a.xmm3, std::ldexp(1.0, scale < 32 ? -static_cast<int>(scale) : 64 - static_cast<int>(scale)));
+         a.mulsd(dst, a.xmm3);
+      }
+   }
+
+   // psq_l is specialised on the GQR value the requesting core had when the
+   //   block was compiled, anything else goes through the interpreter.
    template<unsigned flags = 0>
    static bool
       psqLoad(PPCEmuAssembler& a, Instruction instr)
    {
-      return jit_fallback(a, instr);
+      auto i = (flags & PsqLoadIndexed) ? instr.qi : instr.i;
+      auto w = (flags & PsqLoadIndexed) ? instr.qw : instr.w;
+
+      if (!a.gqrHint.valid) {
+         return jit_fallback(a, instr);
+      }
+
+      gqr_t gqr;
+      gqr.value = a.gqrHint.value[i];
+
+      auto lt = static_cast<QuantizedDataType>(gqr.ld_type);
+      auto ls = gqr.ld_scale;
+      auto c = getQuantizedSize(lt);
+
+      if (!c) {
+         return jit_fallback(a, instr);
+      }
+
+      asmjit::Label slowLbl(a);
+      asmjit::Label doneLbl(a);
+
+      a.cmp(a.ppcgqr[i], gqr.value);
+      a.jne(slowLbl);
+
+      genPsqAddress<flags>(a, instr);
+      genDequantize(a, a.xmm0, lt, ls, 0);
+
+      if (w == 0) {
+         genDequantize(a, a.xmm1, lt, ls, c);
+      } else {
+         loadDouble(a, a.xmm1, 1.0);
+      }
+
+      a.movq(a.ppcfprps[instr.frD][0], a.xmm0);
+      a.movq(a.ppcfprps[instr.frD][1], a.xmm1);
+
+      if (flags & PsqLoadUpdate) {
+         a.storeGpr(instr.rA, a.ecx);
+      }
+
+      a.jmp(doneLbl);
+
+      a.bind(slowLbl);
+      jit_fallback(a, instr);
+
+      a.bind(doneLbl);
+      return true;
    }
 
    static bool
@@ -662,11 +843,104 @@ namespace jit
       PsqStoreIndexed = 1 << 2,
    };
 
+   // Writes src to [rdx + offset], as quantize does, clobbers src
+   static void
+   genQuantize(PPCEmuAssembler& a, const asmjit::X86XmmReg& src, QuantizedDataType type, uint32_t scale, uint32_t offset)
+   {
+      double min, max;
+
+      switch (type) {
+      case QuantizedDataType::Floating:
+         a.cvtsd2ss(src, src);
+         a.movd(a.eax, src);
+         genGuestWrite(a, a.zdx, offset, 4);
+         return;
+      case QuantizedDataType::Unsigned8:
+         min = std::numeric_limits<uint8_t>::min();
+         max = std::numeric_limits<uint8_t>::max();
+         break;
+      case QuantizedDataType::Unsigned16:
+         min = std::numeric_limits<uint16_t>::min();
+         max = std::numeric_limits<uint16_t>::max();
+         break;
+      case QuantizedDataType::Signed8:
+         min = std::numeric_limits<int8_t>::min();
+         max = std::numeric_limits<int8_t>::max();
+         break;
+      case QuantizedDataType::Signed16:
+         min = std::numeric_limits<int16_t>::min();
+         max = std::numeric_limits<int16_t>::max();
+         break;
+      default:
+         assert(0);
+         return;
+      }
+
+      if (scale) {
+         loadDouble(a, a.xmm3, std::ldexp(1.0, scale < 32 ? static_cast<int>(scale) : static_cast<int>(scale) - 64));
+         a.mulsd(src, a.xmm3);
+      }
+
+      // Same operand order as std::max(min, std::min(value, max)) so NaN
+      //   ends up as min like it does in the interpreter.
+      loadDouble(a, a.xmm2, max);
+      a.minsd(a.xmm2, src);
+      loadDouble(a, a.xmm3, min);
+      a.maxsd(a.xmm2, a.xmm3);
+      a.cvttsd2si(a.eax, a.xmm2);
+
+      genGuestWrite(a, a.zdx, offset, getQuantizedSize(type));
+   }
+
    template<unsigned flags = 0>
    static bool
       psqStore(PPCEmuAssembler& a, Instruction instr)
    {
-      return jit_fallback(a, instr);
+      auto i = (flags & PsqStoreIndexed) ? instr.qi : instr.i;
+      auto w = (flags & PsqStoreIndexed) ? instr.qw : instr.w;
+
+      if (!a.gqrHint.valid) {
+         return jit_fallback(a, instr);
+      }
+
+      gqr_t gqr;
+      gqr.value = a.gqrHint.value[i];
+
+      auto stt = static_cast<QuantizedDataType>(gqr.st_type);
+      auto sts = gqr.st_scale;
+      auto c = getQuantizedSize(stt);
+
+      if (!c) {
+         return jit_fallback(a, instr);
+      }
+
+      asmjit::Label slowLbl(a);
+      asmjit::Label doneLbl(a);
+
+      a.cmp(a.ppcgqr[i], gqr.value);
+      a.jne(slowLbl);
+
+      genPsqAddress<flags>(a, instr);
+
+      a.movq(a.xmm0, a.ppcfprps[instr.frS][0]);
+      genQuantize(a, a.xmm0, stt, sts, 0);
+
+      if (w == 0) {
+         a.movq(a.xmm0, a.ppcfprps[instr.frS][1]);
+         genQuantize(a, a.xmm0, stt, sts, c);
+      }
+
+      if (flags & PsqStoreUpdate) {
+         a.storeGpr(instr.rA, a.ecx);
+      }
+
+      a.jmp(doneLbl);
+
+      a.bind(slowLbl);
+      jit_fallback(a, instr);
+
+      a.bind(doneLbl);
+      return true;
    }
 
    static bool
@@ -7,6 +7,364 @@ namespace cpu
 namespace jit
 {
 
+   // Paired singles are held as two adjacent doubles, so the arithmetic maps
+   //   directly onto packed SSE2 instructions. These do not update FPSCR, so
+   //   outside the fast FPSCR mode they go through the interpreter.
+   static void
+   loadPaired(PPCEmuAssembler& a, const asmjit::X86XmmReg& dst, uint32_t fr)
+   {
+      a.movupd(dst, a.ppcfpr[fr]);
+   }
+
+   static void
+   storePaired(PPCEmuAssembler& a, uint32_t fr, const asmjit::X86XmmReg& src)
+   {
+      a.movupd(a.ppcfpr[fr], src);
+   }
+
+   // Loads one half of fr into both halves of dst
+   static void
+   loadSplat(PPCEmuAssembler& a, const asmjit::X86XmmReg& dst, uint32_t fr, uint32_t half)
+   {
+      a.movsd(dst, a.ppcfprps[fr][half]);
+      a.unpcklpd(dst, dst);
+   }
+
+   // Loads 1.0 into both halves of dst
+   static void
+   loadPairedOne(PPCEmuAssembler& a, const asmjit::X86XmmReg& dst)
+   {
+      a.mov(a.zax, 0x3FF0000000000000ull);
+      a.movq(dst, a.zax);
+      a.unpcklpd(dst, dst);
+   }
+
+   // Add, Subtract, Multiply, Divide
+   enum ArithFlags
+   {
+      ArithAdd = 1 << 0,
+      ArithSubtract = 1 << 1,
+      ArithMultiply = 1 << 2,
+      ArithDivide = 1 << 3,
+      ArithScalar0 = 1 << 4,
+      ArithScalar1 = 1 << 5,
+   };
+
+   template<unsigned flags>
+   static bool
+      arithGeneric(PPCEmuAssembler& a, Instruction instr)
+   {
+      if (!isFastFpscr() || instr.rc) {
+         return jit_fallback(a, instr);
+      }
+
+      loadPaired(a, a.xmm0, instr.frA);
+
+      if (flags & ArithScalar0) {
+         loadSplat(a, a.xmm1, instr.frC, 0);
+      } else if (flags & ArithScalar1) {
+         loadSplat(a, a.xmm1, instr.frC, 1);
+      } else if (flags & ArithMultiply) {
+         loadPaired(a, a.xmm1, instr.frC);
+      } else {
+         loadPaired(a, a.xmm1, instr.frB);
+      }
+
+      if (flags & ArithAdd) {
+         a.addpd(a.xmm0, a.xmm1);
+      } else if (flags & ArithSubtract) {
+         a.subpd(a.xmm0, a.xmm1);
+      } else if (flags & ArithMultiply) {
+         a.mulpd(a.xmm0, a.xmm1);
+      } else if (flags & ArithDivide) {
+         a.divpd(a.xmm0, a.xmm1);
+      }
+
+      storePaired(a, instr.frD, a.xmm0);
+      return true;
+   }
+
+   static bool
+      ps_add(PPCEmuAssembler& a, Instruction instr)
+   {
+      return arithGeneric<ArithAdd>(a, instr);
+   }
+
+   static bool
+      ps_sub(PPCEmuAssembler& a, Instruction instr)
+   {
+      return arithGeneric<ArithSubtract>(a, instr);
+   }
+
+   static bool
+      ps_mul(PPCEmuAssembler& a, Instruction instr)
+   {
+      return arithGeneric<ArithMultiply>(a, instr);
+   }
+
+   static bool
+      ps_muls0(PPCEmuAssembler& a, Instruction instr)
+   {
+      return arithGeneric<ArithMultiply | ArithScalar0>(a, instr);
+   }
+
+   static bool
+      ps_muls1(PPCEmuAssembler& a, Instruction instr)
+   {
+      return arithGeneric<ArithMultiply | ArithScalar1>(a, instr);
+   }
+
+   static bool
+      ps_div(PPCEmuAssembler& a, Instruction instr)
+   {
+      return arithGeneric<ArithDivide>(a, instr);
+   }
+
+   // Multiply-Add, Multiply-Subtract
+   enum MaddFlags
+   {
+      MaddPaired = 1 << 0,
+      MaddScalar0 = 1 << 1,
+      MaddScalar1 = 1 << 2,
+      MaddSubtract = 1 << 3,
+      MaddNegate = 1 << 4,
+   };
+
+   template<unsigned flags>
+   static bool
+      maddGeneric(PPCEmuAssembler& a, Instruction instr)
+   {
+      if (!isFastFpscr() || instr.rc) {
+         return jit_fallback(a, instr);
+      }
+
+      loadPaired(a, a.xmm0, instr.frA);
+
+      if (flags & MaddScalar0) {
+         loadSplat(a, a.xmm1, instr.frC, 0);
+      } else if (flags & MaddScalar1) {
+         loadSplat(a, a.xmm1, instr.frC, 1);
+      } else {
+         loadPaired(a, a.xmm1, instr.frC);
+      }
+
+      a.mulpd(a.xmm0, a.xmm1);
+      loadPaired(a, a.xmm1, instr.frB);
+
+      if (flags & MaddSubtract) {
+         a.subpd(a.xmm0, a.xmm1);
+      } else {
+         a.addpd(a.xmm0, a.xmm1);
+      }
+
+      if (flags & MaddNegate) {
+         a.pcmpeqd(a.xmm1, a.xmm1);
+         a.psllq(a.xmm1, 63);
+         a.xorpd(a.xmm0, a.xmm1);
+      }
+
+      storePaired(a, instr.frD, a.xmm0);
+
+      if (instr.rc) {
+         updateFloatConditionRegister(a, a.zax, a.zcx);
+      }
+      return true;
+   }
+
+   static bool
+      ps_madd(PPCEmuAssembler& a, Instruction instr)
+   {
+      return maddGeneric<MaddPaired>(a, instr);
+   }
+
+   static bool
+      ps_madds0(PPCEmuAssembler& a, Instruction instr)
+   {
+      return maddGeneric<MaddScalar0>(a, instr);
+   }
+
+   static bool
+      ps_madds1(PPCEmuAssembler& a, Instruction instr)
+   {
+      return maddGeneric<MaddScalar1>(a, instr);
+   }
+
+   static bool
+      ps_nmadd(PPCEmuAssembler& a, Instruction instr)
+   {
+      return maddGeneric<MaddPaired | MaddNegate>(a, instr);
+   }
+
+   static bool
+      ps_msub(PPCEmuAssembler& a, Instruction instr)
+   {
+      return maddGeneric<MaddPaired | MaddSubtract>(a, instr);
+   }
+
+   static bool
+      ps_nmsub(PPCEmuAssembler& a, Instruction instr)
+   {
+      return maddGeneric<MaddPaired | MaddSubtract | MaddNegate>(a, instr);
+   }
+
+   // Sum
+   enum SumFlags
+   {
+      Sum0 = 1 << 0,
+      Sum1 = 1 << 1
+   };
+
+   template<unsigned flags>
+   static bool
+      sumGeneric(PPCEmuAssembler& a, Instruction instr)
+   {
+      if (!isFastFpscr() || instr.rc) {
+         return jit_fallback(a, instr);
+      }
+
+      a.movsd(a.xmm0, a.ppcfprps[instr.frA][0]);
+      a.addsd(a.xmm0, a.ppcfprps[instr.frB][1]);
+
+      // frD may be frC, read it before writing anything
+      if (flags & Sum0) {
+         a.movsd(a.xmm1, a.ppcfprps[instr.frC][1]);
+         a.movsd(a.ppcfprps[instr.frD][0], a.xmm0);
+         a.movsd(a.ppcfprps[instr.frD][1], a.xmm1);
+      } else {
+         a.movsd(a.xmm1, a.ppcfprps[instr.frC][0]);
+         a.movsd(a.ppcfprps[instr.frD][0], a.xmm1);
+         a.movsd(a.ppcfprps[instr.frD][1], a.xmm0);
+      }
+
+      return true;
+   }
+
+   static bool
+      ps_sum0(PPCEmuAssembler& a, Instruction instr)
+   {
+      return sumGeneric<Sum0>(a, instr);
+   }
+
+   static bool
+      ps_sum1(PPCEmuAssembler& a, Instruction instr)
+   {
+      return sumGeneric<Sum1>(a, instr);
+   }
+
+   // Move, Absolute, Negative Absolute, Negate
+   enum SignFlags
+   {
+      SignClear = 1 << 0,
+      SignSet = 1 << 1,
+      SignFlip = 1 << 2,
+   };
+
+   template<unsigned flags = 0>
+   static bool
+      signGeneric(PPCEmuAssembler& a, Instruction instr)
+   {
+      loadPaired(a, a.xmm0, instr.frB);
+
+      if (flags) {
+         a.pcmpeqd(a.xmm1, a.xmm1);
+      }
+
+      if (flags & SignClear) {
+         a.psrlq(a.xmm1, 1);
+         a.andpd(a.xmm0, a.xmm1);
+      } else if (flags & SignSet) {
+         a.psllq(a.xmm1, 63);
+         a.orpd(a.xmm0, a.xmm1);
+      } else if (flags & SignFlip) {
+         a.psllq(a.xmm1, 63);
+         a.xorpd(a.xmm0, a.xmm1);
+      }
+
+      storePaired(a, instr.frD, a.xmm0);
+
+      if (instr.rc) {
+         updateFloatConditionRegister(a, a.zax, a.zcx);
+      }
+      return true;
+   }
+
+   static bool
+      ps_mr(PPCEmuAssembler& a, Instruction instr)
+   {
+      return signGeneric(a, instr);
+   }
+
+   static bool
+      ps_abs(PPCEmuAssembler& a, Instruction instr)
+   {
+      return signGeneric<SignClear>(a, instr);
+   }
+
+   static bool
+      ps_nabs(PPCEmuAssembler& a, Instruction instr)
+   {
+      return signGeneric<SignSet>(a, instr);
+   }
+
+   static bool
+      ps_neg(PPCEmuAssembler& a, Instruction instr)
+   {
+      return signGeneric<SignFlip>(a, instr);
+   }
+
+   // Select, d = (a >= 0) ? c : b
+   static bool
+      ps_sel(PPCEmuAssembler& a, Instruction instr)
+   {
+      loadPaired(a, a.xmm0, instr.frA);
+      a.xorpd(a.xmm1, a.xmm1);
+      a.cmppd(a.xmm1, a.xmm0, 2); // 0 <= a, false for NaN
+
+      loadPaired(a, a.xmm2, instr.frC);
+      loadPaired(a, a.xmm3, instr.frB);
+      a.andpd(a.xmm2, a.xmm1);
+      a.andnpd(a.xmm1, a.xmm3);
+      a.orpd(a.xmm1, a.xmm2);
+
+      storePaired(a, instr.frD, a.xmm1);
+
+      if (instr.rc) {
+         updateFloatConditionRegister(a, a.zax, a.zcx);
+      }
+      return true;
+   }
+
+   // Reciprocal
+   static bool
+      ps_res(PPCEmuAssembler& a, Instruction instr)
+   {
+      if (!isFastFpscr() || instr.rc) {
+         return jit_fallback(a, instr);
+      }
+
+      loadPairedOne(a, a.xmm0);
+      loadPaired(a, a.xmm1, instr.frB);
+      a.divpd(a.xmm0, a.xmm1);
+      storePaired(a, instr.frD, a.xmm0);
+      return true;
+   }
+
+   // Reciprocal Square Root
+   static bool
+      ps_rsqrte(PPCEmuAssembler& a, Instruction instr)
+   {
+      if (!isFastFpscr() || instr.rc) {
+         return jit_fallback(a, instr);
+      }
+
+      loadPairedOne(a, a.xmm0);
+      loadPaired(a, a.xmm1, instr.frB);
+      a.sqrtpd(a.xmm1, a.xmm1);
+      a.divpd(a.xmm0, a.xmm1);
+      storePaired(a, instr.frD, a.xmm0);
+      return true;
+   }
+
    // Merge registers
    enum MergeFlags
    {
@@ -65,27 +423,27 @@ namespace jit
 
    void registerPairedInstructions()
    {
-      RegisterInstructionFallback(ps_add);
-      RegisterInstructionFallback(ps_div);
-      RegisterInstructionFallback(ps_mul);
-      RegisterInstructionFallback(ps_sub);
-      RegisterInstructionFallback(ps_abs);
-      RegisterInstructionFallback(ps_nabs);
-      RegisterInstructionFallback(ps_neg);
-      RegisterInstructionFallback(ps_sel);
-      RegisterInstructionFallback(ps_res);
-      RegisterInstructionFallback(ps_rsqrte);
-      RegisterInstructionFallback(ps_msub);
-      RegisterInstructionFallback(ps_madd);
-      RegisterInstructionFallback(ps_nmsub);
-      RegisterInstructionFallback(ps_nmadd);
-      RegisterInstructionFallback(ps_mr);
-      RegisterInstructionFallback(ps_sum0);
-      RegisterInstructionFallback(ps_sum1);
-      RegisterInstructionFallback(ps_muls0);
-      RegisterInstructionFallback(ps_muls1);
-      RegisterInstructionFallback(ps_madds0);
-      RegisterInstructionFallback(ps_madds1);
+      RegisterInstruction(ps_add);
+      RegisterInstruction(ps_div);
+      RegisterInstruction(ps_mul);
+      RegisterInstruction(ps_sub);
+      RegisterInstruction(ps_abs);
+      RegisterInstruction(ps_nabs);
+      RegisterInstruction(ps_neg);
+      RegisterInstruction(ps_sel);
+      RegisterInstruction(ps_res);
+      RegisterInstruction(ps_rsqrte);
+      RegisterInstruction(ps_msub);
+      RegisterInstruction(ps_madd);
+      RegisterInstruction(ps_nmsub);
+      RegisterInstruction(ps_nmadd);
+      RegisterInstruction(ps_mr);
+      RegisterInstruction(ps_sum0);
+      RegisterInstruction(ps_sum1);
+      RegisterInstruction(ps_muls0);
+      RegisterInstruction(ps_muls1);
+      RegisterInstruction(ps_madds0);
+      RegisterInstruction(ps_madds1);
       RegisterInstruction(ps_merge00);
       RegisterInstruction(ps_merge01);
       RegisterInstruction(ps_merge10);
@@ -0,0 +1,73 @@
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include "jit.h"
+#include "jit_internal.h"
+#include "../../loader.h"
+#include "log.h"
+
+namespace cpu
+{
+namespace jit
+{
+
+   // Lines of "<host start> <size> <name>" in hex, the format Linux perf
+   //   reads for JIT code from /tmp/perf-<pid>.map. Native Windows
+   //   profilers don't read it, so this only works under Wine.
+   static std::mutex sPerfMapMutex;
+   static FILE *sPerfMap = nullptr;
+
+   // perf looks the map up by the unix pid, which Wine doesn't give out,
+   //   but /proc/self is opened by this process so its stat starts with it.
+   static bool
+   getHostPid(unsigned long& pid)
+   {
+      auto file = fopen("Z:\\proc\\self\\stat", "r");
+      if (!file) {
+         return false;
+      }
+
+      auto found = fscanf(file, "%lu", &pid) == 1;
+      fclose(file);
+      return found;
+   }
+
+   bool openPerfMap()
+   {
+      unsigned long pid;
+      if (!getHostPid(pid)) {
+         gLog->error("JIT perf maps are only read by Linux perf, could not find the pid of the Wine process");
+         return false;
+      }
+
+      auto path = fmt::format("Z:\\tmp\\perf-{}.map", pid);
+
+      std::unique_lock<std::mutex> lock(sPerfMapMutex);
+      sPerfMap = fopen(path.c_str(), "w");
+      if (!sPerfMap) {
+         gLog->error("Could not open JIT perf map {}", path);
+         return false;
+      }
+
+      gLog->info("Writing JIT perf map to {}", path);
+      return true;
+   }
+
+   void writePerfMap(const JitBlock& block)
+   {
+      if (!sPerfMap || !block.code) {
+         return;
+      }
+
+      auto name = fmt::format("ppc_{:08X} {}", block.start, gLoader.findSymbol(block.start));
+
+      // Flush every block, the map is read while the process is running
+      std::unique_lock<std::mutex> lock(sPerfMapMutex);
+      fprintf(sPerfMap, "%llx %x %s\n",
+              static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(block.code)),
+              block.codeSize, name.c_str());
+      fflush(sPerfMap);
+   }
+
+}
+}
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "jit.h"
+#include "jit_internal.h"
+#include "../../loader.h"
+#include "log.h"
+
+namespace cpu
+{
+namespace jit
+{
+
+   // Nodes of a map never move, so generated code can hold pointers
+   static std::mutex sProfileMutex;
+   static std::map<uint32_t, JitProfile> sProfiles;
+
+   JitProfile *getProfile(uint32_t start)
+   {
+      if (cpu::getJitProfileMode() == cpu::JitProfileMode::Disabled) {
+         return nullptr;
+      }
+
+      std::unique_lock<std::mutex> lock(sProfileMutex);
+      auto &profile = sProfiles[start];
+      profile.start = start;
+      return &profile;
+   }
+
+   void genProfileEntry(PPCEmuAssembler& a)
+   {
+      if (!a.profile) {
+         return;
+      }
+
+      a.mov(a.zcx, reinterpret_cast<uint64_t>(a.profile));
+      a.inc(asmjit::x86::qword_ptr(a.zcx, offsetof(JitProfile, entries)));
+
+      if (cpu::getJitProfileMode() != cpu::JitProfileMode::Cycles) {
+         return;
+      }
+
+      // Charge the cycles since the last block entry to that block
+      asmjit::Label noBlockLbl(a);
+      a.rdtsc();
+      a.shl(a.zdx, 32);
+      a.or_(a.zax, a.zdx);
+      a.mov(a.zdx, a.ppcprofileBlock);
+      a.test(a.zdx, a.zdx);
+      a.jz(noBlockLbl);
+      a.mov(a.r8, a.zax);
+      a.sub(a.r8, a.ppcprofileStart);
+      a.add(asmjit::x86::qword_ptr(a.zdx, offsetof(JitProfile, cycles)), a.r8);
+      a.bind(noBlockLbl);
+      a.mov(a.ppcprofileBlock, a.zcx);
+      a.mov(a.ppcprofileStart, a.zax);
+   }
+
+   void dumpProfile(unsigned count)
+   {
+      std::vector<JitProfile> profiles;
+      uint64_t totalEntries = 0;
+      uint64_t totalCycles = 0;
+
+      {
+         std::unique_lock<std::mutex> lock(sProfileMutex);
+
+         for (auto &itr : sProfiles) {
+            if (itr.second.entries) {
+               profiles.push_back(itr.second);
+               totalEntries += itr.second.entries;
+               totalCycles += itr.second.cycles;
+            }
+         }
+      }
+
+      // Rank by cycles when they were measured, otherwise by entries
+      std::sort(profiles.begin(), profiles.end(), [totalCycles](const JitProfile &lhs, const JitProfile &rhs) {
+         if (totalCycles) {
+            return lhs.cycles > rhs.cycles;
+         } else {
+            return lhs.entries > rhs.entries;
+         }
+      });
+
+      gLog->info("JIT profile of {} blocks, {} entries, {} cycles", profiles.size(), totalEntries, totalCycles);
+
+      for (auto i = 0u; i < profiles.size() && i < count; ++i) {
+         auto &profile = profiles[i];
+         auto share = totalCycles ? 100.0 * profile.cycles / totalCycles : 100.0 * profile.entries / totalEntries;
+
+         gLog->info("{:08X} {:>12} entries {:>14} cycles {:6.2f}% {:>10} fallbacks {}",
+                    profile.start, profile.entries, profile.cycles, share, profile.fallbacks, gLoader.findSymbol(profile.start));
+      }
+   }
+
+}
+}
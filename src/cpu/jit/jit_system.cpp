@@ -50,34 +50,34 @@ namespace jit
          a.mov(a.eax, a.ppcctr);
          break;
       case SprEncoding::GQR0:
-         a.mov(a.eax, a.ppcgpr[0]);
+         a.mov(a.eax, a.ppcgqr[0]);
          break;
       case SprEncoding::GQR1:
-         a.mov(a.eax, a.ppcgpr[1]);
+         a.mov(a.eax, a.ppcgqr[1]);
          break;
       case SprEncoding::GQR2:
-         a.mov(a.eax, a.ppcgpr[2]);
+         a.mov(a.eax, a.ppcgqr[2]);
          break;
       case SprEncoding::GQR3:
-         a.mov(a.eax, a.ppcgpr[3]);
+         a.mov(a.eax, a.ppcgqr[3]);
          break;
       case SprEncoding::GQR4:
-         a.mov(a.eax, a.ppcgpr[4]);
+         a.mov(a.eax, a.ppcgqr[4]);
          break;
       case SprEncoding::GQR5:
-         a.mov(a.eax, a.ppcgpr[5]);
+         a.mov(a.eax, a.ppcgqr[5]);
          break;
       case SprEncoding::GQR6:
-         a.mov(a.eax, a.ppcgpr[6]);
+         a.mov(a.eax, a.ppcgqr[6]);
          break;
       case SprEncoding::GQR7:
-         a.mov(a.eax, a.ppcgpr[7]);
+         a.mov(a.eax, a.ppcgqr[7]);
          break;
       default:
          gLog->error("Invalid mfspr SPR {}", static_cast<uint32_t>(spr));
       }
 
-      a.mov(a.ppcgpr[instr.rD], a.eax);
+      a.storeGpr(instr.rD, a.eax);
       return true;
    }
 
@@ -85,7 +85,7 @@ namespace jit
    static bool
       mtspr(PPCEmuAssembler& a, Instruction instr)
    {
-      a.mov(a.eax, a.ppcgpr[instr.rD]);
+      a.loadGpr(a.eax, instr.rD);
 
       auto spr = decodeSPR(instr);
       switch (spr) {
@@ -142,9 +142,12 @@ namespace jit
          return false;
       }
 
+      a.flushGprs();
+      a.materializeCia();
       a.mov(a.zcx, a.state);
-      a.mov(a.zdx, asmjit::Ptr(kc->second));
-      a.call(asmjit::Ptr(kc->first));
+      a.mov(a.zdx, a.hostLiteral(JitRelocKind::KernelCallData, id, kc->second));
+      a.call(a.hostLiteral(JitRelocKind::KernelCallFn, id, reinterpret_cast<const void*>(kc->first)));
+      a.reloadGprs();
       return true;
    }
 
@@ -0,0 +1,197 @@
+#include <cstring>
+#include <mutex>
+#include <map>
+#include <set>
+#include <vector>
+#include "jit.h"
+#include "jit_internal.h"
+#include "../disassembler.h"
+#include "../instructiondata.h"
+#include "../interpreter/interpreter.h"
+#include "../../mem/mem.h"
+#include "../../trace.h"
+#include "log.h"
+
+namespace cpu
+{
+namespace jit
+{
+
+   // Gives up on a shadow run which never leaves the block
+   static const uint32_t JIT_VERIFY_MAX_STEPS = 1 << 20;
+
+   using BlockRanges = std::vector<std::pair<uint32_t, uint32_t>>;
+
+#ifdef JIT_VERIFY_ENABLED
+
+   // Holds the stores of the shadow run, keyed by byte address, so guest
+   //   memory and the other cores never see them.
+   struct ShadowMemory : mem::Overlay
+   {
+      std::map<uint32_t, uint8_t> bytes;
+
+      void read(ppcaddr_t address, void *data, uint32_t size) override
+      {
+         auto out = reinterpret_cast<uint8_t*>(data);
+         memcpy(out, mem::translate(address), size);
+
+         for (auto itr = bytes.lower_bound(address); itr != bytes.end() && itr->first - address < size; ++itr) {
+            out[itr->first - address] = itr->second;
+         }
+      }
+
+      void write(ppcaddr_t address, const void *data, uint32_t size) override
+      {
+         auto in = reinterpret_cast<const uint8_t*>(data);
+
+         for (auto i = 0u; i < size; ++i) {
+            bytes[address + i] = in[i];
+         }
+      }
+   };
+
+   // Each block is only reported the first time it diverges
+   static std::mutex sReportedMutex;
+   static std::set<uint32_t> sReportedBlocks;
+
+   static bool
+   inRanges(const BlockRanges& ranges, uint32_t address)
+   {
+      for (auto &range : ranges) {
+         if (address >= range.first && address < range.second) {
+            return true;
+         }
+      }
+
+      return false;
+   }
+
+   // Kernel calls can't be run twice, their effects go beyond the state
+   //   and memory the shadow run captures.
+   static bool
+   canVerify(const BlockRanges& ranges)
+   {
+      if (ranges.empty()) {
+         return false;
+      }
+
+      for (auto &range : ranges) {
+         for (auto address = range.first; address < range.second; address += 4) {
+            auto data = gInstructionTable.decode(mem::read<Instruction>(address));
+
+            if (!data || data->id == InstructionID::kc || data->id == InstructionID::sc) {
+               return false;
+            }
+         }
+      }
+
+      return true;
+   }
+
+   // Returns a description of the first difference between the JIT and
+   //   interpreter results, or an empty string if they match. Memory is
+   //   only compared where the interpreter stored.
+   static std::string
+   findDivergence(const ThreadState *jitState, uint32_t jitNia,
+                  const ThreadState *interpState, const ShadowMemory& shadowMemory)
+   {
+      if (jitNia != interpState->nia) {
+         return fmt::format("nia is {:08x} after JIT, {:08x} after interpreter", jitNia, interpState->nia);
+      }
+
+      for (uint32_t field = StateField::GPR0; field < StateField::Max; ++field) {
+         TraceFieldValue jitValue, interpValue;
+
+         // Fast mode skips FPSCR updates on purpose
+         if (field == StateField::FPSCR && cpu::getJitFpscrMode() == cpu::JitFpscrMode::Fast) {
+            continue;
+         }
+
+         saveStateField(jitState, field, jitValue);
+         saveStateField(interpState, field, interpValue);
+
+         if (jitValue.value != interpValue.value) {
+            return fmt::format("{} is {:016x}:{:016x} after JIT, {:016x}:{:016x} after interpreter",
+                               getStateFieldName(field),
+                               jitValue.u64v1, jitValue.u64v0, interpValue.u64v1, interpValue.u64v0);
+         }
+      }
+
+      for (auto &byte : shadowMemory.bytes) {
+         auto memory = *mem::translate(byte.first);
+
+         if (memory != byte.second) {
+            return fmt::format("byte at {:08x} is {:02x} after JIT, {:02x} after interpreter",
+                               byte.first, memory, byte.second);
+         }
+      }
+
+      return {};
+   }
+
+   static void
+   reportDivergence(uint32_t entry, const BlockRanges& ranges, const std::string& divergence)
+   {
+      {
+         std::unique_lock<std::mutex> lock(sReportedMutex);
+         if (!sReportedBlocks.insert(entry).second) {
+            return;
+         }
+      }
+
+      gLog->error("JIT block entered at {:08x} does not match the interpreter: {}", entry, divergence);
+
+      for (auto &range : ranges) {
+         for (auto address = range.first; address < range.second; address += 4) {
+            Disassembly dis;
+            gDisassembler.disassemble(mem::read<Instruction>(address), dis, address);
+            gLog->error("  {:08x} {}", address, dis.text);
+         }
+      }
+   }
+
+   uint32_t verifyBlock(ThreadState *state, JitCode block, const BlockRanges& ranges)
+   {
+      if (!canVerify(ranges)) {
+         return execute(state, block);
+      }
+
+      auto entry = state->nia;
+      auto shadow = *state;
+      ShadowMemory shadowMemory;
+      auto steps = 0u;
+
+      mem::tOverlay = &shadowMemory;
+
+      do {
+         interpreter::executeInstruction(&shadow);
+      } while (inRanges(ranges, shadow.nia) && ++steps < JIT_VERIFY_MAX_STEPS);
+
+      mem::tOverlay = nullptr;
+
+      auto nia = execute(state, block);
+
+      if (steps >= JIT_VERIFY_MAX_STEPS) {
+         gLog->warn("Interpreter did not leave the JIT block entered at {:08x}, not verified", entry);
+         return nia;
+      }
+
+      auto divergence = findDivergence(state, nia, &shadow, shadowMemory);
+      if (!divergence.empty()) {
+         reportDivergence(entry, ranges, divergence);
+      }
+
+      return nia;
+   }
+
+#else
+
+   uint32_t verifyBlock(ThreadState *state, JitCode block, const BlockRanges& ranges)
+   {
+      return execute(state, block);
+   }
+
+#endif
+
+}
+}
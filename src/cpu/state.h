@@ -394,6 +394,15 @@ enum class SprEncoding
    PIR = 0x3FF,
 };
 
+// Return address of a call and the JIT code which continues from it
+struct rsb_entry_t
+{
+   uint32_t lr;
+   void *host;
+};
+
+static const uint32_t ReturnStackSize = 16;
+
 // Thread registers
 // TODO: Some system registers may not be thread-specific!
 struct ThreadState
@@ -425,4 +434,13 @@ struct ThreadState
    bool reserve;
    uint32_t reserveAddress;
    uint32_t reserveData;
+
+                     // JIT return stack buffer, predicts the target of blr
+   rsb_entry_t rsb[ReturnStackSize];
+   uint32_t rsbTop;
+   uint32_t rsbGeneration;
+
+                     // JIT profiler, block being charged and when it was entered
+   void *profileBlock;
+   uint64_t profileStart;
 };
@@ -95,6 +95,18 @@ DebugControl::preLaunch()
 }
 
 
+// Whether code from addr has to go through maybeBreak per instruction,
+//   true while a pause is pending or addr's page has a breakpoint.
+bool
+DebugControl::needsStep(uint32_t addr)
+{
+   if (!gDebugger.isEnabled()) {
+      return false;
+   }
+
+   return mWaitingForPause.load() || gDebugger.hasBreakpointPage(addr);
+}
+
 void
 DebugControl::maybeBreak(uint32_t addr, ThreadState *state, uint32_t coreId)
 {
@@ -115,7 +127,12 @@ DebugControl::maybeBreak(uint32_t addr, ThreadState *state, uint32_t coreId)
       return;
    }
 
-   BreakpointList bps = gDebugger.getBreakpoints();
+   // Almost every instruction is on a page without breakpoints
+   if (!gDebugger.hasBreakpointPage(addr)) {
+      return;
+   }
+
+   BreakpointList bps = std::atomic_load(&gDebugger.getBreakpoints());
    uint32_t bpUserData = 0;
    bool isBpAddr = false;
    auto bpitr = bps->find(addr);
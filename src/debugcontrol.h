@@ -15,6 +15,7 @@ public:
 
    void preLaunch();
    void maybeBreak(uint32_t addr, ThreadState *state, uint32_t coreIdx);
+   bool needsStep(uint32_t addr);
 
    void pauseCore(ThreadState *state, uint32_t coreId);
    void pauseAll();
@@ -6,6 +6,7 @@
 #include <sstream>
 #include <atomic>
 #include <iostream>
+#include "cpu/cpu.h"
 #include "debugger.h"
 #include "log.h"
 #include "processor.h"
@@ -21,6 +22,9 @@ gDebugger;
 Debugger::Debugger()
    : mEnabled(false), mBreakpoints(new BreakpointListType())
 {
+   for (auto &bits : mBreakpointPages) {
+      bits.store(0);
+   }
 }
 
 void
@@ -159,10 +163,42 @@ Debugger::stepCore(uint32_t coreId)
    gDebugControl.stepCore(coreId);
 }
 
+bool
+Debugger::hasBreakpoint(uint32_t addr) const
+{
+   if (!hasBreakpointPage(addr)) {
+      return false;
+   }
+
+   auto bps = std::atomic_load(&mBreakpoints);
+   return bps->find(addr) != bps->end();
+}
+
+// Sets the page bit of addr if any breakpoint is left in its page, and
+//   drops code compiled from the address so it picks up the change.
+void
+Debugger::updateBreakpointPage(uint32_t addr)
+{
+   auto page = addr >> BreakpointPageShift;
+   auto start = page << BreakpointPageShift;
+   auto end = start + (1 << BreakpointPageShift);
+   auto bps = std::atomic_load(&mBreakpoints);
+   auto itr = bps->lower_bound(start);
+
+   if (itr != bps->end() && (end == 0 || itr->first < end)) {
+      mBreakpointPages[page / 32].fetch_or(1u << (page % 32));
+   } else {
+      mBreakpointPages[page / 32].fetch_and(~(1u << (page % 32)));
+   }
+
+   cpu::invalidateCode(addr, 4);
+}
+
 void
 Debugger::addBreakpoint(uint32_t addr, uint32_t userData)
 {
    assert(mEnabled);
+   std::unique_lock<std::mutex> lock { mBreakpointMutex };
 
    while (true) {
       BreakpointList oldList = mBreakpoints;
@@ -177,12 +213,15 @@ Debugger::addBreakpoint(uint32_t addr, uint32_t userData)
       // Successful swap!
       break;
    }
+
+   updateBreakpointPage(addr);
 }
 
 void
 Debugger::removeBreakpoint(uint32_t addr)
 {
    assert(mEnabled);
+   std::unique_lock<std::mutex> lock { mBreakpointMutex };
 
    while (true) {
       BreakpointList oldList = mBreakpoints;
@@ -199,6 +238,8 @@ Debugger::removeBreakpoint(uint32_t addr)
 
       break;
    }
+
+   updateBreakpointPage(addr);
 }
 
 
@@ -63,16 +63,32 @@ public:
       return mBreakpoints;
    }
 
+   // Whether any breakpoint lies in the 4 KiB page holding addr
+   bool hasBreakpointPage(uint32_t addr) const {
+      auto page = addr >> BreakpointPageShift;
+      return !!(mBreakpointPages[page / 32].load(std::memory_order_relaxed) & (1u << (page % 32)));
+   }
+
+   bool hasBreakpoint(uint32_t addr) const;
+
    void notify(DebugMessage *msg);
 
 protected:
+   static const uint32_t BreakpointPageShift = 12;
+   static const uint32_t BreakpointPageCount = 1 << (32 - BreakpointPageShift);
+
    void handleMessage(DebugMessage *pak);
    void debugThread();
+   void updateBreakpointPage(uint32_t addr);
 
    bool mEnabled;
    std::thread mDebuggerThread;
    BreakpointList mBreakpoints;
 
+   // Serialises breakpoint changes so the page bits match the list
+   std::mutex mBreakpointMutex;
+   std::atomic<uint32_t> mBreakpointPages[BreakpointPageCount / 32];
+
    std::queue<DebugMessage*> mMsgQueue;
    std::mutex mMsgLock;
    std::condition_variable mMsgCond;
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <random>
 #include <string>
 #include "fuzztests.h"
@@ -509,6 +510,73 @@ executeInstrTest(uint32_t test_seed)
    return true;
 }
 
+// Checks the flat decode table against the opcode tree on random
+//   encodings and reports how long each takes to decode them.
+static bool
+benchmarkDecode(uint32_t seed)
+{
+   static const auto count = 1 << 22;
+   std::mt19937 rand(seed);
+   std::vector<Instruction> instrs;
+   auto mismatches = 0u;
+
+   instrs.reserve(count);
+
+   for (auto i = 0; i < count; ++i) {
+      // Keep the opcode fields of a known instruction half of the time,
+      //   random encodings are mostly invalid.
+      auto value = static_cast<uint32_t>(rand());
+
+      if (i & 1) {
+         auto id = static_cast<InstructionID>(rand() % static_cast<uint32_t>(InstructionID::InstructionCount));
+         auto base = gInstructionTable.encode(id);
+         auto data = gInstructionTable.find(id);
+         uint32_t mask = 0;
+
+         for (auto &op : data->opcode) {
+            mask |= getFieldBitmask(op.field);
+         }
+
+         value = (value & ~mask) | base.value;
+      }
+
+      instrs.push_back(value);
+   }
+
+   for (auto instr : instrs) {
+      if (gInstructionTable.decode(instr) != gInstructionTable.decodeTree(instr)) {
+         if (mismatches++ < 16) {
+            gLog->error("Decode of {:08x} does not match the opcode tree", instr.value);
+         }
+      }
+   }
+
+   auto decodeAll = [&instrs](InstructionData *(InstructionTable::*decode)(Instruction)) {
+      auto start = std::chrono::high_resolution_clock::now();
+      uintptr_t sum = 0;
+
+      for (auto instr : instrs) {
+         sum += reinterpret_cast<uintptr_t>((gInstructionTable.*decode)(instr));
+      }
+
+      auto end = std::chrono::high_resolution_clock::now();
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+      return std::make_pair(static_cast<double>(ns) / instrs.size(), sum);
+   };
+
+   auto tree = decodeAll(&InstructionTable::decodeTree);
+   auto flat = decodeAll(&InstructionTable::decode);
+
+   gLog->info("Decode: opcode tree {:.2f}ns, flat table {:.2f}ns per instruction", tree.first, flat.first);
+
+   if (mismatches) {
+      gLog->error("{} of {} decodes did not match the opcode tree", mismatches, instrs.size());
+      return false;
+   }
+
+   return tree.second == flat.second;
+}
+
 bool
 executeFuzzTests(uint32_t suite_seed)
 {
@@ -516,6 +584,10 @@ executeFuzzTests(uint32_t suite_seed)
       return false;
    }
 
+   if (!benchmarkDecode(suite_seed)) {
+      return false;
+   }
+
    mem::alloc(instructionBase, 32);
    mem::alloc(dataBase, 128);
 
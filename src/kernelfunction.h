@@ -21,6 +21,10 @@ struct KernelFunction : KernelExport
    uint32_t syscallID;
    uint32_t vaddr;
    virtual void call(ThreadState *state) = 0;
+
+   // Same as call, but as a plain function taking this as userData so
+   //   a kernel call can go straight to the marshalling for this export.
+   void (*invoke)(ThreadState *state, void *userData) = nullptr;
 };
 
 namespace kernel
@@ -35,10 +39,21 @@ struct KernelFunctionImpl : KernelFunction
 {
    Ret(*wrapped_function)(Args...);
 
+   KernelFunctionImpl()
+   {
+      invoke = &invokeKernelFunction;
+   }
+
    virtual void call(ThreadState *thread) override
    {
       ppctypes::invoke(thread, wrapped_function, this->name);
    }
+
+   static void invokeKernelFunction(ThreadState *thread, void *userData)
+   {
+      auto func = static_cast<KernelFunctionImpl*>(static_cast<KernelFunction*>(userData));
+      ppctypes::invoke(thread, func->wrapped_function, func->name);
+   }
 };
 
 };
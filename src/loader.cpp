@@ -10,6 +10,7 @@
 #include "bigendianview.h"
 #include "elf.h"
 #include "filesystem/filesystem.h"
+#include "cpu/cpu.h"
 #include "cpu/instructiondata.h"
 #include "kernelmodule.h"
 #include "loader.h"
@@ -245,10 +246,13 @@ Loader::loadRPL(std::string name)
    }
 
    // Check if we already have this module loaded
-   auto itr = mModules.find(name);
+   {
+      std::unique_lock<std::mutex> lock { mModuleMutex };
+      auto itr = mModules.find(name);
 
-   if (itr != mModules.end()) {
-      return itr->second.get();
+      if (itr != mModules.end()) {
+         return itr->second.get();
+      }
    }
 
    // Try to find module in system kernel library list
@@ -280,11 +284,49 @@ Loader::loadRPL(std::string name)
    } else {
       auto result = module.get();
       gLog->info("Loaded module {}", name);
+
+      std::unique_lock<std::mutex> lock { mModuleMutex };
       mModules.emplace(name, std::move(module));
       return result;
    }
 }
 
+std::string
+Loader::findSymbol(ppcaddr_t address) const
+{
+   std::unique_lock<std::mutex> lock { mModuleMutex };
+
+   for (auto &itr : mModules) {
+      auto &module = itr.second;
+      auto inModule = std::any_of(module->sections.begin(), module->sections.end(),
+         [address](const LoadedSection &section) {
+            return address >= section.start && address < section.end;
+         });
+
+      if (!inModule) {
+         continue;
+      }
+
+      const std::string *name = nullptr;
+      uint32_t best = 0;
+
+      for (auto &symbol : module->symbols) {
+         if (symbol.second <= address && symbol.second >= best) {
+            name = &symbol.first;
+            best = symbol.second;
+         }
+      }
+
+      if (name) {
+         return fmt::format("{}:{}+0x{:X}", module->name, *name, address - best);
+      }
+
+      return module->name;
+   }
+
+   return "?";
+}
+
 
 std::unique_ptr<LoadedModule>
 Loader::loadKernelModule(const std::string &name, KernelModule *module)
@@ -831,6 +873,9 @@ Loader::loadRPL(const std::string& name, const gsl::array_view<uint8_t> &data)
       loadedMod->sections.emplace_back(LoadedSection { "loader_thunks", trampSeg.first, trampSeg.second });
    }
 
+   // The code heap may hand out memory which held an earlier module
+   cpu::invalidateCode(mem::untranslate(codeSegAddr), info.textSize);
+
    // Free the load segment
    OSFreeToSystem(loadSegAddr);
    //mCodeHeap->free(loadSegAddr);
@@ -2,6 +2,7 @@
 #include <array_view.h>
 #include <string>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <map>
 #include "elf.h"
@@ -80,6 +81,9 @@ public:
       return mModules;
    }
 
+   // Nearest symbol at or below address, safe to call from any thread
+   std::string findSymbol(ppcaddr_t address) const;
+
 private:
    ppcaddr_t registerUnimplementedData(const std::string& name);
    ppcaddr_t registerUnimplementedFunction(const std::string& name);
@@ -92,6 +96,8 @@ private:
    bool processRelocations(LoadedModule *loadedMod, const SectionList &sections, BigEndianView &in, const char *shStrTab, SequentialMemoryTracker &codeSeg, AddressRange &trampSeg);
 
 private:
+   // Held while mModules is searched or grows
+   mutable std::mutex mModuleMutex;
    ModuleList mModules;
    std::map<std::string, ppcaddr_t> mUnimplementedFunctions;
    std::map<std::string, int> mUnimplementedData;
@@ -6,7 +6,9 @@
 #include "filesystem/filesystem.h"
 
 #include "cpu/cpu.h"
+#include "cpu/jit/jit.h"
 #include "processor.h"
+#include "replay.h"
 #include "loader.h"
 #include "log.h"
 #include "memory.h"
@@ -42,14 +44,14 @@ gLog;
 void initialiseEmulator();
 bool test(const std::string &as, const std::string &path);
 bool fuzzTest();
-bool play(const fs::HostPath &path);
+bool play(const fs::HostPath &path, bool jitCache);
 
 static const char USAGE[] =
 R"(WiiU Emulator
 
 Usage:
-   wiiu play [--jit | --jitdebug] [--logfile] [--log-async] [--log-level=<log-level>] <game directory>
-   wiiu test [--jit | --jitdebug] [--logfile] [--log-async] [--log-level=<log-level>] [--as=<ppcas>] <test directory>
+   wiiu play [--jit | --jit-tiered | --jitdebug | --interpreter-threaded] [--jit-threads=<n>] [--jit-fast-fpscr] [--jit-cache] [--jit-profile | --jit-profile-cycles] [--jit-perf-map] [--record=<journal> | --replay=<journal>] [--logfile] [--log-async] [--log-level=<log-level>] <game directory>
+   wiiu test [--jit | --jit-tiered | --jitdebug] [--jit-threads=<n>] [--jit-fast-fpscr] [--logfile] [--log-async] [--log-level=<log-level>] [--as=<ppcas>] <test directory>
    wiiu fuzz
    wiiu (-h | --help)
    wiiu --version
@@ -58,6 +60,30 @@ Options:
    -h --help     Show this screen.
    --version     Show version.
    --jit         Enables the JIT engine.
+   --jit-tiered  Interpret code until it is hot, then JIT it.
+   --jitdebug    Check every JIT block against the interpreter and log
+                  where they differ. Needs a build with JIT_VERIFY_ENABLED.
+   --interpreter-threaded
+                  Interpret whole blocks between interrupt checks.
+   --jit-threads=<n>
+                  Compile JIT blocks on n background threads, interpreting
+                  them until they are ready [default: 0].
+   --jit-fast-fpscr
+                  Skip FPSCR exception and result flag updates in JIT
+                  float code, most games never read them.
+   --jit-cache   Reuse JIT code saved by the previous run of the game.
+   --jit-profile Count entries and fallbacks of each JIT block and log the
+                  hottest blocks on exit.
+   --jit-profile-cycles
+                  As --jit-profile, also attributing host cycles to blocks.
+   --jit-perf-map
+                  Write /tmp/perf-<pid>.map so Linux perf can name JIT
+                  blocks. Only works under Wine with Z: mapped to /.
+   --record=<journal>
+                  Record time and controller inputs to a journal.
+   --replay=<journal>
+                  Feed the inputs of a recorded journal back to the game.
+                  Both log a per thread checksum of the times read on exit.
    --logfile     Redirect log output to file.
    --log-async   Enable asynchronous logging.
    --log-level=<log-level> [default: trace]
@@ -81,10 +107,34 @@ int main(int argc, char **argv)
       cpu::setJitMode(cpu::JitMode::Debug);
    } else if (args["--jit"].asBool()) {
       cpu::setJitMode(cpu::JitMode::Enabled);
+   } else if (args["--jit-tiered"].asBool()) {
+      cpu::setJitMode(cpu::JitMode::Tiered);
    } else {
       cpu::setJitMode(cpu::JitMode::Disabled);
    }
 
+   if (args["--interpreter-threaded"].asBool()) {
+      cpu::setInterpreterMode(cpu::InterpreterMode::Threaded);
+   } else {
+      cpu::setInterpreterMode(cpu::InterpreterMode::Stepped);
+   }
+
+   cpu::setJitCompileThreads(static_cast<unsigned>(args["--jit-threads"].asLong()));
+
+   if (args["--jit-fast-fpscr"].asBool()) {
+      cpu::setJitFpscrMode(cpu::JitFpscrMode::Fast);
+   } else {
+      cpu::setJitFpscrMode(cpu::JitFpscrMode::Accurate);
+   }
+
+   if (args["--jit-profile-cycles"].asBool()) {
+      cpu::setJitProfileMode(cpu::JitProfileMode::Cycles);
+   } else if (args["--jit-profile"].asBool()) {
+      cpu::setJitProfileMode(cpu::JitProfileMode::Counts);
+   } else {
+      cpu::setJitProfileMode(cpu::JitProfileMode::Disabled);
+   }
+
    // Create the logger
    std::vector<spdlog::sink_ptr> sinks;
    sinks.push_back(std::make_shared<spdlog::sinks::stdout_sink_st>());
@@ -118,9 +168,20 @@ int main(int argc, char **argv)
 
    initialiseEmulator();
 
+   if (args["--jit-perf-map"].asBool()) {
+      cpu::jit::openPerfMap();
+   }
+
    if (args["play"].asBool()) {
+      if (args["--record"].isString()) {
+         replay::startRecord(args["--record"].asString());
+      } else if (args["--replay"].isString()) {
+         replay::startReplay(args["--replay"].asString());
+      }
+
       gLog->set_pattern("[%l:%t] %v");
-      result = play(args["<game directory>"].asString());
+      result = play(args["<game directory>"].asString(), args["--jit-cache"].asBool());
+      replay::stop();
    } else if (args["fuzz"].asBool()) {
       gLog->set_pattern("%v");
       result = fuzzTest();
@@ -191,7 +252,7 @@ fuzzTest()
 }
 
 static bool
-play(const fs::HostPath &path)
+play(const fs::HostPath &path, bool jitCache)
 {
    // Setup filesystem
    fs::FileSystem fs;
@@ -227,6 +288,11 @@ play(const fs::HostPath &path)
    // Set up stuff..
    gLoader.initialise(maxCodeSize);
 
+   auto jitCachePath = rpx + ".jitcache";
+   if (jitCache) {
+      cpu::jit::loadCache(jitCachePath);
+   }
+
    // System preloaded modules
    gLoader.loadRPL("gameloader");
    gLoader.loadRPL("coreinit");
@@ -255,6 +321,14 @@ play(const fs::HostPath &path)
 
    platform::ui::run();
 
+   if (jitCache) {
+      cpu::jit::saveCache(jitCachePath);
+   }
+
+   if (cpu::getJitProfileMode() != cpu::JitProfileMode::Disabled) {
+      cpu::jit::dumpProfile();
+   }
+
    // Force inclusion in release builds
    tracePrint(nullptr, 0, 0);
 
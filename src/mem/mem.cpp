@@ -50,8 +50,12 @@ namespace mem
 
 
    uint8_t *gBase = nullptr;
+#ifdef JIT_VERIFY_ENABLED
+   thread_local Overlay *tOverlay = nullptr;
+#endif
    void *sFile = NULL;
    std::vector<MemoryView> sViews;
+   std::vector<void*> sGaps;
 
    void unmapViews()
    {
@@ -83,6 +87,39 @@ namespace mem
       return true;
    }
 
+   static void
+   reserveRange(uint64_t start, uint64_t end)
+   {
+      if (start >= end) {
+         return;
+      }
+
+      auto ptr = VirtualAlloc(gBase + start, static_cast<SIZE_T>(end - start), MEM_RESERVE, PAGE_NOACCESS);
+
+      if (!ptr) {
+         gLog->warn("Could not reserve guest address space {:08x}-{:08x}", start, end);
+         return;
+      }
+
+      sGaps.push_back(ptr);
+   }
+
+   // Reserve the address space between views so that generated code
+   //   accessing any unmapped guest address faults instead of reaching
+   //   whatever the host happened to allocate there.
+   static void
+   reserveGaps()
+   {
+      auto start = 0ull;
+
+      for (auto &view : sViews) {
+         reserveRange(start, view.start);
+         start = view.end;
+      }
+
+      reserveRange(start, 0x100000000ull);
+   }
+
    void initialise()
    {
       // Setup memory views
@@ -111,6 +148,8 @@ namespace mem
          throw;
       }
 
+      reserveGaps();
+
       // Setup page table
       for (auto &view : sViews) {
          auto size = view.end - view.start;
@@ -278,6 +317,12 @@ namespace mem
          unmapViews();
          CloseHandle(sFile);
       }
+
+      for (auto gap : sGaps) {
+         VirtualFree(gap, 0, MEM_RELEASE);
+      }
+
+      sGaps.clear();
    }
 
 }
\ No newline at end of file
@@ -2,11 +2,29 @@
 #include <cassert>
 #include "types.h"
 
+// Define to let --jitdebug run its shadow interpreter against a private
+//   memory overlay. Without it guest loads and stores skip the overlay
+//   check and --jitdebug runs blocks unverified.
+//#define JIT_VERIFY_ENABLED
+
 namespace mem
 {
    
    extern uint8_t *gBase;
 
+#ifdef JIT_VERIFY_ENABLED
+   // While set, loads and stores on this thread go through the overlay
+   //   instead of guest memory, the JIT verifier uses it for a shadow run
+   //   of the interpreter which other cores can't observe.
+   struct Overlay
+   {
+      virtual void read(ppcaddr_t address, void *data, uint32_t size) = 0;
+      virtual void write(ppcaddr_t address, const void *data, uint32_t size) = 0;
+   };
+
+   extern thread_local Overlay *tOverlay;
+#endif
+
    void initialise();
 
    bool valid(ppcaddr_t address);
@@ -61,6 +79,14 @@ namespace mem
    template<typename Type>
    static inline Type readNoSwap(ppcaddr_t address)
    {
+#ifdef JIT_VERIFY_ENABLED
+      if (tOverlay) {
+         Type value;
+         tOverlay->read(address, &value, sizeof(Type));
+         return value;
+      }
+#endif
+
       return *reinterpret_cast<Type*>(translate(address));
    }
 
@@ -75,6 +101,13 @@ namespace mem
    template<typename Type>
    static inline void writeNoSwap(ppcaddr_t address, Type value)
    {
+#ifdef JIT_VERIFY_ENABLED
+      if (tOverlay) {
+         tOverlay->write(address, &value, sizeof(Type));
+         return;
+      }
+#endif
+
       *reinterpret_cast<Type*>(translate(address)) = value;
    }
 
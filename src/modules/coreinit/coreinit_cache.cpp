@@ -1,5 +1,7 @@
 #include "coreinit.h"
 #include "coreinit_cache.h"
+#include "cpu/cpu.h"
+#include "mem/mem.h"
 #include "util.h"
 
 void
@@ -8,10 +10,13 @@ DCInvalidateRange(void *addr, uint32_t size)
    // TODO: DCInvalidateRange
 }
 
+// Games flush the data cache after writing code, so this is where any
+// JIT code or predecoded instructions from the old contents of the range
+// are dropped.
 void
 DCFlushRange(void *addr, uint32_t size)
 {
-   // TODO: DCFlushRange
+   cpu::invalidateCode(mem::untranslate(addr), size);
 }
 
 void
@@ -23,7 +28,7 @@ DCStoreRange(void *addr, uint32_t size)
 void
 DCFlushRangeNoSync(void *addr, uint32_t size)
 {
-   // TODO: DCFlushRangeNoSync
+   cpu::invalidateCode(mem::untranslate(addr), size);
 }
 
 void
@@ -47,6 +52,12 @@ DCTouchRange(void *addr, uint32_t size)
    // TODO: DCTouchRange
 }
 
+void
+ICInvalidateRange(void *addr, uint32_t size)
+{
+   cpu::invalidateCode(mem::untranslate(addr), size);
+}
+
 void
 CoreInit::registerCacheFunctions()
 {
@@ -57,4 +68,5 @@ CoreInit::registerCacheFunctions()
    RegisterKernelFunction(DCStoreRangeNoSync);
    RegisterKernelFunction(DCZeroRange);
    RegisterKernelFunction(DCTouchRange);
+   RegisterKernelFunction(ICInvalidateRange);
 }
\ No newline at end of file
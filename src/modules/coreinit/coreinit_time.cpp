@@ -2,6 +2,7 @@
 #include "coreinit.h"
 #include "coreinit_time.h"
 #include "coreinit_systeminfo.h"
+#include "replay.h"
 
 // Time since epoch
 OSTime
@@ -55,12 +56,38 @@ OSTicksToCalendarTime(OSTime time, OSCalendarTime *calendarTime)
    calendarTime->tm_year = tm.tm_year + 1900; // posix tm_year is year - 1900
 }
 
+// The guest exports are the only calls journaled for replay, host side
+// callers such as OSCheckAlarms run at timer dependent moments.
+static OSTime
+GuestOSGetTime()
+{
+   return replay::journalValue(replay::Event::Time, OSGetTime());
+}
+
+static OSTime
+GuestOSGetSystemTime()
+{
+   return GuestOSGetTime() - OSGetSystemInfo()->baseTime;
+}
+
+static OSTick
+GuestOSGetTick()
+{
+   return GuestOSGetTime() & 0xFFFFFFFF;
+}
+
+static OSTick
+GuestOSGetSystemTick()
+{
+   return GuestOSGetSystemTime() & 0xFFFFFFFF;
+}
+
 void
 CoreInit::registerTimeFunctions()
 {
-   RegisterKernelFunction(OSGetTime);
-   RegisterKernelFunction(OSGetTick);
-   RegisterKernelFunction(OSGetSystemTime);
-   RegisterKernelFunction(OSGetSystemTick);
+   RegisterKernelFunctionName("OSGetTime", GuestOSGetTime);
+   RegisterKernelFunctionName("OSGetTick", GuestOSGetTick);
+   RegisterKernelFunctionName("OSGetSystemTime", GuestOSGetSystemTime);
+   RegisterKernelFunctionName("OSGetSystemTick", GuestOSGetSystemTick);
    RegisterKernelFunction(OSTicksToCalendarTime);
 }
@@ -1,5 +1,6 @@
 #include "padscore.h"
 #include "padscore_kpad_status.h"
+#include "replay.h"
 
 // Returns number of KPADStatus buffers filled or negative is an error code
 int32_t
@@ -29,6 +30,7 @@ KPADReadEx(uint32_t chan, KPADStatus *buffers, uint32_t count, be_val<int32_t> *
    }
 
    memset(&buffers[0], 0, sizeof(KPADStatus));
+   replay::journal(replay::Event::KPADRead, &buffers[0], sizeof(KPADStatus));
    return 1;
 }
 
@@ -1,5 +1,6 @@
 #include "vpad.h"
 #include "vpad_status.h"
+#include "replay.h"
 
 int32_t
 VPADRead(uint32_t chan, VPADStatus *buffers, uint32_t count, be_val<int32_t> *error)
@@ -11,6 +12,7 @@ VPADRead(uint32_t chan, VPADStatus *buffers, uint32_t count, be_val<int32_t> *er
       *error = 0;
    }
 
+   replay::journal(replay::Event::VPADRead, &buffers[0], sizeof(VPADStatus));
    return 1;
 }
 
@@ -0,0 +1,191 @@
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "log.h"
+#include "mem/mem.h"
+#include "modules/coreinit/coreinit_thread.h"
+#include "replay.h"
+
+namespace replay
+{
+
+static const uint32_t JournalMagic = 0x524A5557; // "WUJR"
+static const uint32_t JournalVersion = 1;
+
+// Each record is this header followed by size bytes of input
+#pragma pack(push, 1)
+struct RecordHeader
+{
+   Event event;
+   uint32_t thread;
+   uint32_t size;
+};
+#pragma pack(pop)
+
+using StreamKey = std::pair<Event, uint32_t>;
+
+// Running summary of the inputs a thread saw, logged on stop so a record
+// run and its replay can be checked against each other.
+struct StreamSummary
+{
+   uint32_t count = 0;
+   uint32_t checksum = 2166136261u;
+};
+
+static Mode sMode = Mode::Disabled;
+static std::mutex sMutex;
+static std::ofstream sRecordFile;
+static std::map<StreamKey, std::deque<std::vector<uint8_t>>> sStreams;
+static std::map<StreamKey, StreamSummary> sSummaries;
+static bool sDiverged = false;
+
+// Inputs are keyed on the guest thread reading them, so each thread sees
+// the same sequence whichever core it is scheduled on.
+static uint32_t
+getThreadKey()
+{
+   auto thread = OSGetCurrentThread();
+   return thread ? mem::untranslate(thread) : 0;
+}
+
+// FNV-1a over every input byte the guest was handed
+static void
+summarise(StreamSummary &summary, const void *data, uint32_t size)
+{
+   auto bytes = reinterpret_cast<const uint8_t*>(data);
+
+   for (auto i = 0u; i < size; ++i) {
+      summary.checksum = (summary.checksum ^ bytes[i]) * 16777619u;
+   }
+
+   summary.count++;
+}
+
+bool
+startRecord(const std::string &path)
+{
+   std::unique_lock<std::mutex> lock { sMutex };
+   sRecordFile.open(path, std::ofstream::out | std::ofstream::binary);
+
+   if (!sRecordFile.is_open()) {
+      gLog->error("Could not open replay journal {} for writing", path);
+      return false;
+   }
+
+   sRecordFile.write(reinterpret_cast<const char*>(&JournalMagic), sizeof(uint32_t));
+   sRecordFile.write(reinterpret_cast<const char*>(&JournalVersion), sizeof(uint32_t));
+   sMode = Mode::Record;
+   gLog->info("Recording guest inputs to {}", path);
+   return true;
+}
+
+bool
+startReplay(const std::string &path)
+{
+   std::unique_lock<std::mutex> lock { sMutex };
+   std::ifstream file { path, std::ifstream::in | std::ifstream::binary };
+   uint32_t magic, version;
+   auto count = 0u;
+
+   if (!file.is_open()) {
+      gLog->error("Could not open replay journal {}", path);
+      return false;
+   }
+
+   if (!file.read(reinterpret_cast<char*>(&magic), sizeof(uint32_t))
+    || !file.read(reinterpret_cast<char*>(&version), sizeof(uint32_t))
+    || magic != JournalMagic || version != JournalVersion) {
+      gLog->error("{} is not a replay journal of this version", path);
+      return false;
+   }
+
+   RecordHeader header;
+   while (file.read(reinterpret_cast<char*>(&header), sizeof(RecordHeader))) {
+      std::vector<uint8_t> data(header.size);
+
+      if (!file.read(reinterpret_cast<char*>(data.data()), header.size)) {
+         gLog->warn("Replay journal {} is truncated", path);
+         break;
+      }
+
+      sStreams[{ header.event, header.thread }].push_back(std::move(data));
+      count++;
+   }
+
+   sMode = Mode::Replay;
+   sSummaries.clear();
+   sDiverged = false;
+   gLog->info("Replaying {} guest inputs from {}", count, path);
+   return true;
+}
+
+void
+stop()
+{
+   std::unique_lock<std::mutex> lock { sMutex };
+
+   if (sMode == Mode::Record) {
+      sRecordFile.close();
+   }
+
+   for (auto &itr : sSummaries) {
+      if (itr.first.first == Event::Time) {
+         gLog->info("Replay thread {:08x} read {} times, checksum {:08x}",
+                    itr.first.second, itr.second.count, itr.second.checksum);
+      }
+   }
+
+   for (auto &itr : sStreams) {
+      if (!itr.second.empty()) {
+         gLog->warn("Replay left {} inputs {} of thread {:08x} unread",
+                    itr.second.size(), static_cast<int>(itr.first.first), itr.first.second);
+      }
+   }
+
+   sSummaries.clear();
+   sStreams.clear();
+   sMode = Mode::Disabled;
+}
+
+Mode
+getMode()
+{
+   return sMode;
+}
+
+void
+journal(Event event, void *data, uint32_t size)
+{
+   if (sMode == Mode::Disabled) {
+      return;
+   }
+
+   std::unique_lock<std::mutex> lock { sMutex };
+   auto thread = getThreadKey();
+
+   if (sMode == Mode::Record) {
+      RecordHeader header = { event, thread, size };
+      sRecordFile.write(reinterpret_cast<const char*>(&header), sizeof(RecordHeader));
+      sRecordFile.write(reinterpret_cast<const char*>(data), size);
+   } else if (sMode == Mode::Replay) {
+      auto itr = sStreams.find({ event, thread });
+
+      // Past this point the guest is running on live inputs again
+      if (itr == sStreams.end() || itr->second.empty() || itr->second.front().size() != size) {
+         if (!sDiverged) {
+            gLog->warn("Replay diverged on input {} of thread {:08x}", static_cast<int>(event), thread);
+            sDiverged = true;
+         }
+      } else {
+         memcpy(data, itr->second.front().data(), size);
+         itr->second.pop_front();
+      }
+   }
+
+   summarise(sSummaries[{ event, thread }], data, size);
+}
+
+} // namespace replay
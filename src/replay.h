@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace replay
+{
+
+enum class Mode
+{
+   Disabled,
+   Record,
+   Replay,
+};
+
+// Nondeterministic inputs to the guest, journaled per guest thread
+enum class Event : uint8_t
+{
+   Time,
+   VPADRead,
+   KPADRead,
+};
+
+bool
+startRecord(const std::string &path);
+
+bool
+startReplay(const std::string &path);
+
+void
+stop();
+
+Mode
+getMode();
+
+// Records size bytes at data, or when replaying overwrites them with the
+// next recorded input of this event for the current guest thread.
+void
+journal(Event event, void *data, uint32_t size);
+
+template<typename Type>
+Type
+journalValue(Event event, Type value)
+{
+   if (getMode() != Mode::Disabled) {
+      journal(event, &value, sizeof(Type));
+   }
+
+   return value;
+}
+
+} // namespace replay
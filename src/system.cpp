@@ -27,10 +27,12 @@ kcstub(ThreadState *state, void *userData)
    func->call(state);
 }
 
+// Implemented functions are called directly, skipping kcstub
 void
 System::registerSysCall(KernelFunction *func)
 {
-   func->syscallID = cpu::registerKernelCall(cpu::KernelCallEntry(kcstub, func));
+   auto fn = (func->valid && func->invoke) ? func->invoke : kcstub;
+   func->syscallID = cpu::registerKernelCall(cpu::KernelCallEntry(fn, func));
    mSystemCalls[func->syscallID] = func;
 }
 
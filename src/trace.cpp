@@ -39,7 +39,7 @@ getStateFieldName(TraceFieldType type)
    } else if (type >= StateField::FPR0 && type <= StateField::FPR31) {
       return fmt::format("f{:02}", type - StateField::FPR);
    } else if (type >= StateField::GQR0 && type <= StateField::GQR7) {
-      return fmt::format("q{:02}", type - StateField::FPR);
+      return fmt::format("q{:02}", type - StateField::GQR);
    } else if (type == StateField::CR) {
       return "CR";
    } else if (type == StateField::XER) {
@@ -50,6 +50,8 @@ getStateFieldName(TraceFieldType type)
       return "FPSCR";
    } else if (type == StateField::CTR) {
       return "CTR";
+   } else if (type == StateField::ReserveAddress) {
+      return "RESERVE";
    } else {
       assert(0);
       return "UNK";
@@ -123,12 +125,21 @@ getTrace(Tracer *tracer, int index)
 size_t
 getTracerNumTraces(Tracer *tracer)
 {
+   if (!tracer) {
+      return 0;
+   }
+
    return tracer->numTraces;
 }
 
 void
 traceInit(ThreadState *state, size_t size)
 {
+   if (!TraceEnabled) {
+      state->tracer = nullptr;
+      return;
+   }
+
    state->tracer = new Tracer();
    state->tracer->index = 0;
    state->tracer->numTraces = 0;
@@ -298,9 +309,9 @@ restoreStateField(ThreadState *state, TraceFieldType type, const TraceFieldValue
    }
 }
 
-template<typename T>
+template<typename List>
 static void
-pushUniqueField(std::vector<T> &fields, uint32_t fieldId)
+pushUniqueField(List &fields, uint32_t fieldId)
 {
    if (fieldId == StateField::Invalid) {
       return;
@@ -386,7 +397,14 @@ traceInstructionStart(Instruction instr, InstructionData *data, ThreadState *sta
       saveStateField(state, i.type, i.prevalue);
    }
 
-   tracer->prevState = *state;
+   // Only kc needs the whole state to find what it changed
+#ifndef TRACE_VERIFICATION
+   if (data->id == InstructionID::kc)
+#endif
+   {
+      tracer->prevState = *state;
+   }
+
    return &trace;
 }
 
@@ -447,6 +465,10 @@ traceInstructionEnd(Trace *trace, Instruction instr, InstructionData *data, Thre
 void
 tracePrint(ThreadState *state, int start, int count)
 {
+   if (!state || !state->tracer) {
+      return;
+   }
+
    auto tracer = state->tracer;
    auto tracerSize = static_cast<int>(getTracerNumTraces(tracer));
 
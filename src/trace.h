@@ -1,7 +1,19 @@
 #pragma once
+#include <cstddef>
+#include <type_traits>
 #include <vector>
 #include "cpu/instruction.h"
 
+// Define to record the last instructions run by every thread. Without it
+//   no tracer is allocated and the interpreter loops have no trace code.
+//#define TRACE_ENABLED
+
+#ifdef TRACE_ENABLED
+static const bool TraceEnabled = true;
+#else
+static const bool TraceEnabled = false;
+#endif
+
 struct InstructionData;
 struct ThreadState;
 struct Tracer;
@@ -83,6 +95,60 @@ saveStateField(const ThreadState *state, TraceFieldType type, TraceFieldValue &f
 void
 restoreStateField(ThreadState *state, TraceFieldType type, const TraceFieldValue &field);
 
+// Fixed capacity list so trace records can be reused without allocating,
+//   fields past the capacity are dropped.
+template<typename Type, size_t Capacity>
+struct TraceFieldList
+{
+   Type *begin()
+   {
+      return items;
+   }
+
+   Type *end()
+   {
+      return items + count;
+   }
+
+   const Type *begin() const
+   {
+      return items;
+   }
+
+   const Type *end() const
+   {
+      return items + count;
+   }
+
+   const Type &front() const
+   {
+      return items[0];
+   }
+
+   size_t size() const
+   {
+      return count;
+   }
+
+   void clear()
+   {
+      count = 0;
+   }
+
+   void push_back(const Type &item)
+   {
+      if (count < Capacity) {
+         items[count++] = item;
+      }
+   }
+
+   uint32_t count;
+   Type items[Capacity];
+};
+
+// Enough for lmw / stmw touching every GPR plus the fixed fields
+static const size_t TraceMaxFields = 40;
+
 struct Trace
 {
    struct _R {
@@ -97,9 +163,10 @@ struct Trace
 
    Instruction instr;
    uint32_t cia;
-   std::vector<_R> reads;
-   std::vector<_W> writes;
+   TraceFieldList<_R, TraceMaxFields> reads;
+   TraceFieldList<_W, TraceMaxFields> writes;
 };
+static_assert(std::is_trivially_copyable<Trace>::value, "Trace records must be plain data");
 
 const Trace& getTrace(Tracer *tracer, int index);
 